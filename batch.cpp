@@ -0,0 +1,246 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include "batch.h"
+#include "model.h"
+
+// reads n comma separated numbers that make up the whole of text
+static bool parseFloats(const char *text, float *values, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        char *end;
+        values[i] = strtof(text, &end);
+        if (end == text || *end != (i + 1 < n ? ',' : '\0'))
+        {
+            return false;
+        }
+        text = end + 1;
+    }
+    return true;
+}
+
+bool parseVec3(const char *text, Vec3f &v)
+{
+    return parseFloats(text, v.raw, 3);
+}
+
+static bool parseSize(const char *text, int &width, int &height)
+{
+    char *end;
+    long w = strtol(text, &end, 10);
+    if (end == text || *end != 'x')
+    {
+        return false;
+    }
+    text = end + 1;
+    long h = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || w <= 0 || h <= 0 || w > 65535 || h > 65535)
+    {
+        return false;
+    }
+    width = (int) w;
+    height = (int) h;
+    return true;
+}
+
+bool parseViewSetting(const std::string &setting, int &width, int &height, Camera &camera)
+{
+    size_t eq = setting.find('=');
+    if (eq == std::string::npos)
+    {
+        return false;
+    }
+    std::string key = setting.substr(0, eq);
+    const char *value = setting.c_str() + eq + 1;
+    if (key == "size")
+    {
+        return parseSize(value, width, height);
+    } else if (key == "eye")
+    {
+        return parseVec3(value, camera.eye);
+    } else if (key == "center")
+    {
+        return parseVec3(value, camera.center);
+    } else if (key == "up")
+    {
+        return parseVec3(value, camera.up);
+    } else if (key == "fov")
+    {
+        return parseFloats(value, &camera.fov, 1) && camera.fov >= 0 && camera.fov < 180;
+    } else if (key == "scale")
+    {
+        return parseFloats(value, &camera.scale, 1) && camera.scale > 0;
+    } else if (key == "near")
+    {
+        return parseFloats(value, &camera.zNear, 1);
+    } else if (key == "far")
+    {
+        return parseFloats(value, &camera.zFar, 1);
+    }
+    return false;
+}
+
+bool parseSampleCount(const char *text, int &samples)
+{
+    char *end;
+    long n = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || (n != 1 && !samplePattern((int) n)))
+    {
+        return false;
+    }
+    samples = (int) n;
+    return true;
+}
+
+bool readManifest(const char *filename, std::vector<BatchJob> &jobs, std::string &error)
+{
+    std::ifstream in(filename);
+    if (!in)
+    {
+        error = "can't open file";
+        return false;
+    }
+    std::string line;
+    for (int lineNo = 1; std::getline(in, line); lineNo++)
+    {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos)
+        {
+            line.erase(hash);
+        }
+        std::istringstream tokens(line);
+        BatchJob job;
+        if (!(tokens >> job.model))
+        {
+            continue;
+        }
+        std::ostringstream where;
+        where << "line " << lineNo << ": ";
+        if (!(tokens >> job.output))
+        {
+            error = where.str() + "missing output path";
+            return false;
+        }
+        job.width = 800;
+        job.height = 800;
+        job.samples = 0;
+        job.line = lineNo;
+        std::string token;
+        while (tokens >> token)
+        {
+            bool ok = token.compare(0, 5, "msaa=") ? parseViewSetting(token, job.width, job.height, job.camera)
+                                                   : parseSampleCount(token.c_str() + 5, job.samples);
+            if (!ok)
+            {
+                error = where.str() + "bad setting " + token;
+                return false;
+            }
+        }
+        if (job.camera.degenerate())
+        {
+            error = where.str() + "degenerate camera";
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct LoadedModel
+{
+    std::unique_ptr<Model> model;
+    double loadMs;
+};
+
+struct JobResult
+{
+    int triangles;
+    double renderMs;
+    double writeMs;
+    const char *status;
+};
+
+int runBatch(const std::vector<BatchJob> &jobs, const RenderSettings &settings, int modelFlags, ThreadPool &pool,
+             FramePool &frames, const char *summaryPath)
+{
+    auto batchStart = std::chrono::steady_clock::now();
+    // the parser already spreads a single large model over all cores, so models load one by one
+    std::map<std::string, LoadedModel> models;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        LoadedModel &loaded = models[jobs[i].model];
+        if (!loaded.model)
+        {
+            auto start = std::chrono::steady_clock::now();
+            loaded.model.reset(new Model(jobs[i].model.c_str(), modelFlags));
+            loaded.loadMs = millisecondsSince(start);
+        }
+    }
+
+    std::vector<JobResult> results(jobs.size());
+    pool.parallelFor((int) jobs.size(), [&](int i) {
+        const BatchJob &job = jobs[i];
+        JobResult &result = results[i];
+        result.triangles = 0;
+        result.renderMs = 0;
+        result.writeMs = 0;
+        const Model &model = *models.find(job.model)->second.model;
+        if (!model.good())
+        {
+            result.status = "load-failed";
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        RenderSettings jobSettings = settings;
+        jobSettings.camera = job.camera;
+        if (job.samples)
+        {
+            jobSettings.samples = job.samples;
+        }
+        TGAImage image(job.width, job.height, TGAImage::RGB, &frames);
+        FrameRenderer renderer;
+        result.triangles = renderer.render(model, jobSettings, image);
+        result.renderMs = millisecondsSince(start);
+        start = std::chrono::steady_clock::now();
+        bool written = write_tga_file(image.view().flipped_vertically(), job.output.c_str());
+        result.writeMs = millisecondsSince(start);
+        result.status = written ? "ok" : "write-failed";
+    });
+
+    int failed = 0;
+    std::ofstream summary(summaryPath);
+    summary << "line\tmodel\toutput\twidth\theight\ttriangles\tload_ms\trender_ms\twrite_ms\tstatus\n";
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        const BatchJob &job = jobs[i];
+        const JobResult &result = results[i];
+        // a model is loaded once, so every job using it reports the same load time
+        summary << job.line << "\t" << job.model << "\t" << job.output << "\t" << job.width << "\t" << job.height
+                << "\t" << result.triangles << "\t" << models[job.model].loadMs << "\t" << result.renderMs << "\t"
+                << result.writeMs << "\t" << result.status << "\n";
+        if (strcmp(result.status, "ok"))
+        {
+            std::cerr << "job at line " << job.line << ": " << result.status << "\n";
+            failed++;
+        }
+    }
+    summary.close();
+    if (!summary)
+    {
+        std::cerr << "can't write summary " << summaryPath << "\n";
+    }
+    std::cerr << "# jobs " << jobs.size() << " models " << models.size() << " failed " << failed << " in "
+              << millisecondsSince(batchStart) << " ms" << std::endl;
+    return failed;
+}
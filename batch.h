@@ -0,0 +1,45 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <string>
+#include <vector>
+#include "framepool.h"
+#include "renderer.h"
+#include "threadpool.h"
+
+struct BatchJob
+{
+    std::string model;
+    std::string output;
+    int width;
+    int height;
+    Camera camera;
+    int samples; // 0 keeps the sample count of the batch settings
+    int line;    // in the manifest
+};
+
+// A manifest holds one job per line: the model path and the output path, then optional
+// key=value settings, all separated by blanks:
+//   size=WxH (800x800)  eye=x,y,z  center=x,y,z  up=x,y,z  fov=degrees  scale=s  near=d  far=d
+//   msaa=1|4|8
+// Everything after a '#' is a comment. Relative paths are taken from the working directory.
+// On malformed input returns false and sets error to "line N: what went wrong".
+bool readManifest(const char *filename, std::vector<BatchJob> &jobs, std::string &error);
+
+// Applies one size or camera setting as written in a manifest, "eye=0,0,3" say. Returns false
+// for unknown keys and malformed values.
+bool parseViewSetting(const std::string &setting, int &width, int &height, Camera &camera);
+
+// three comma separated numbers, "1,0.5,2" say
+bool parseVec3(const char *text, Vec3f &v);
+
+// 1, 4 or 8 samples per pixel
+bool parseSampleCount(const char *text, int &samples);
+
+// Loads every model named by the jobs once, renders the jobs concurrently on the pool, one
+// job per worker at a time, and writes a tab separated summary with one row of timings per
+// job. Frame buffers are borrowed from frames. Returns the number of jobs that failed.
+int runBatch(const std::vector<BatchJob> &jobs, const RenderSettings &settings, int modelFlags, ThreadPool &pool,
+             FramePool &frames, const char *summaryPath);
+
+#endif //__BATCH_H__
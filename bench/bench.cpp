@@ -0,0 +1,629 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+#include "rasterizer.h"
+#include "renderer.h"
+#include "tgaimage.h"
+#include "threadpool.h"
+#include "wireframe.h"
+
+// Micro and frame benchmarks of the renderer. Every benchmark runs a warm-up call, picks how
+// many calls make one sample last at least --min-time, then times --runs samples. Statistics
+// are per call. Inputs are african_head.obj and synthetic triangle sets drawn from a fixed seed,
+// so two builds benchmarked with the same options do the same work.
+
+const int BENCH_WIDTH = 800;
+const int BENCH_HEIGHT = 800;
+const unsigned BENCH_SEED = 20240601;
+// synthetic rasterizer sets are cut down to about this many pixels of triangle area per call
+const double RASTER_SET_PIXELS = 1 << 20;
+
+enum SizeDistribution
+{
+    SIZES_FIXED, SIZES_UNIFORM, SIZES_EXPONENTIAL
+};
+
+struct BenchOptions
+{
+    const char *modelPath;
+    const char *filter;
+    const char *jsonPath;
+    const char *baselinePath;
+    int runs;
+    double minTimeMs;
+    int triangles;           // in every synthetic mesh
+    std::vector<int> sizes;  // mean triangle edge lengths in pixels, one synthetic set each
+    SizeDistribution distribution;
+    int threads;
+    double threshold; // median slowdown against the baseline reported as a regression
+
+    BenchOptions() : modelPath("obj/african_head.obj"), filter(nullptr), jsonPath(nullptr), baselinePath(nullptr),
+                     runs(15), minTimeMs(20), triangles(10000), sizes(), distribution(SIZES_UNIFORM), threads(1),
+                     threshold(0.1)
+    {
+        sizes.push_back(4);
+        sizes.push_back(16);
+        sizes.push_back(64);
+    }
+};
+
+struct Benchmark
+{
+    std::string name;
+    std::function<void()> body;
+    double pixels;    // per call, 0 if it does not apply
+    double triangles; // per call, 0 if it does not apply
+};
+
+struct BenchResult
+{
+    std::string name;
+    int iterations; // calls per sample
+    int runs;
+    double medianMs;
+    double p95Ms;
+    double minMs;
+    double pixelsPerSecond;
+    double trianglesPerSecond;
+};
+
+// Screen space triangles, counter-clockwise with y up, fully inside the image.
+struct TriangleSet
+{
+    std::string name;
+    std::vector<Vec3f> points; // three per triangle
+    double pixels;             // summed area
+};
+
+static const char *distributionName(SizeDistribution distribution)
+{
+    const char *names[] = {"fixed", "uniform", "exponential"};
+    return names[distribution];
+}
+
+static bool parseDistribution(const char *name, SizeDistribution &distribution)
+{
+    for (int i = SIZES_FIXED; i <= SIZES_EXPONENTIAL; i++)
+    {
+        if (!strcmp(name, distributionName((SizeDistribution) i)))
+        {
+            distribution = (SizeDistribution) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseSizes(const char *text, std::vector<int> &sizes)
+{
+    sizes.clear();
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        int size = atoi(item.c_str());
+        if (size < 1 || size > BENCH_WIDTH / 2)
+        {
+            return false;
+        }
+        sizes.push_back(size);
+    }
+    return !sizes.empty();
+}
+
+// Edge lengths are fixed, uniform in [size / 2, 3 size / 2] or exponential with mean size, the
+// long tail of large triangles real meshes tend to have. Corners sit on a jittered circle around
+// a random center, far enough from the border to stay inside the image.
+static TriangleSet makeTriangleSet(int count, int size, SizeDistribution distribution, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::exponential_distribution<float> exponential(1.f / size);
+    TriangleSet set;
+    set.name = std::string(distributionName(distribution)) + "-" + std::to_string(size);
+    set.points.reserve(3 * count);
+    set.pixels = 0;
+    float maxEdge = BENCH_WIDTH / 2 - 2;
+    for (int i = 0; i < count; i++)
+    {
+        float edge = size;
+        if (distribution == SIZES_UNIFORM)
+        {
+            edge = size * (0.5f + unit(rng));
+        } else if (distribution == SIZES_EXPONENTIAL)
+        {
+            edge = exponential(rng);
+        }
+        edge = std::min(std::max(edge, 1.f), maxEdge);
+        float radius = edge / std::sqrt(3.f);
+        float margin = 1.2f * radius + 1;
+        float cx = margin + unit(rng) * (BENCH_WIDTH - 2 * margin);
+        float cy = margin + unit(rng) * (BENCH_HEIGHT - 2 * margin);
+        float angle = unit(rng) * 2 * (float) M_PI;
+        float z = unit(rng);
+        Vec3f corners[3];
+        for (int k = 0; k < 3; k++)
+        {
+            float a = angle + k * 2 * (float) M_PI / 3 + (unit(rng) - 0.5f) * 0.5f;
+            float r = radius * (0.8f + 0.4f * unit(rng));
+            corners[k] = Vec3f(cx + r * std::cos(a), cy + r * std::sin(a), z);
+            set.points.push_back(corners[k]);
+        }
+        set.pixels += 0.5 * ((corners[1].x - corners[0].x) * (corners[2].y - corners[0].y) -
+                             (corners[1].y - corners[0].y) * (corners[2].x - corners[0].x));
+    }
+    return set;
+}
+
+// Writes a triangle set as an OBJ mesh in the [-1, 1] square the default camera shows, so every
+// face is front facing and lands where the set would have been drawn. Vertices are not shared.
+static bool writeSyntheticObj(const TriangleSet &set, const std::string &filename, unsigned seed)
+{
+    std::ofstream out(filename.c_str());
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> tilt(-1.f, 1.f);
+    out << std::setprecision(7) << "# " << set.points.size() / 3 << " triangles, " << set.name << "\n";
+    for (size_t i = 0; i < set.points.size(); i += 3)
+    {
+        float z = tilt(rng) * 0.9f;
+        for (int k = 0; k < 3; k++)
+        {
+            const Vec3f &p = set.points[i + k];
+            // a small depth slope per face varies the lighting
+            out << "v " << p.x / BENCH_WIDTH * 2 - 1 << " " << p.y / BENCH_HEIGHT * 2 - 1 << " "
+                << z + tilt(rng) * 0.01f << "\n";
+        }
+    }
+    for (size_t i = 0; i < set.points.size(); i += 3)
+    {
+        out << "f " << i + 1 << " " << i + 2 << " " << i + 3 << "\n";
+    }
+    return (bool) out;
+}
+
+static bool parseOptions(int argc, char **argv, BenchOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (!strncmp(arg, "--filter=", 9))
+        {
+            options.filter = arg + 9;
+        } else if (!strncmp(arg, "--json=", 7))
+        {
+            options.jsonPath = arg + 7;
+        } else if (!strncmp(arg, "--baseline=", 11))
+        {
+            options.baselinePath = arg + 11;
+        } else if (!strncmp(arg, "--runs=", 7))
+        {
+            options.runs = atoi(arg + 7);
+            if (options.runs <= 0)
+            {
+                std::cerr << "bad run count " << arg + 7 << "\n";
+                return false;
+            }
+        } else if (!strncmp(arg, "--min-time=", 11))
+        {
+            options.minTimeMs = atof(arg + 11);
+        } else if (!strncmp(arg, "--triangles=", 12))
+        {
+            options.triangles = atoi(arg + 12);
+            if (options.triangles <= 0)
+            {
+                std::cerr << "bad triangle count " << arg + 12 << "\n";
+                return false;
+            }
+        } else if (!strncmp(arg, "--sizes=", 8))
+        {
+            if (!parseSizes(arg + 8, options.sizes))
+            {
+                std::cerr << "bad triangle sizes " << arg + 8 << "\n";
+                return false;
+            }
+        } else if (!strncmp(arg, "--distribution=", 15))
+        {
+            if (!parseDistribution(arg + 15, options.distribution))
+            {
+                std::cerr << "unknown size distribution " << arg + 15 << "\n";
+                return false;
+            }
+        } else if (!strncmp(arg, "--threads=", 10))
+        {
+            options.threads = atoi(arg + 10);
+        } else if (!strncmp(arg, "--threshold=", 12))
+        {
+            options.threshold = atof(arg + 12) / 100;
+        } else if (arg[0] == '-')
+        {
+            std::cerr << "unknown option " << arg << "\n";
+            return false;
+        } else
+        {
+            options.modelPath = arg;
+        }
+    }
+    return true;
+}
+
+static double millisecondsFor(const std::function<void()> &body, int iterations)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        body();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static BenchResult measure(const Benchmark &bench, const BenchOptions &options)
+{
+    BenchResult result;
+    result.name = bench.name;
+    result.runs = options.runs;
+    double once = millisecondsFor(bench.body, 1);
+    result.iterations = once >= options.minTimeMs ? 1 : (int) std::min(1e6, std::ceil(options.minTimeMs / std::max(once, 1e-4)));
+    millisecondsFor(bench.body, result.iterations);
+    std::vector<double> times(options.runs);
+    for (int r = 0; r < options.runs; r++)
+    {
+        times[r] = millisecondsFor(bench.body, result.iterations) / result.iterations;
+    }
+    std::sort(times.begin(), times.end());
+    int n = options.runs;
+    result.medianMs = n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+    result.p95Ms = times[std::max(0, (int) std::ceil(0.95 * n) - 1)];
+    result.minMs = times[0];
+    result.pixelsPerSecond = bench.pixels * 1000 / result.medianMs;
+    result.trianglesPerSecond = bench.triangles * 1000 / result.medianMs;
+    return result;
+}
+
+// Reads the name and median of every result in a file written by writeJson(), which puts each
+// result on a line of its own.
+static bool readBaseline(const char *filename, std::map<std::string, double> &medians)
+{
+    std::ifstream in(filename);
+    if (!in)
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t name = line.find("\"name\": \"");
+        size_t median = line.find("\"median_ms\": ");
+        if (name == std::string::npos || median == std::string::npos)
+        {
+            continue;
+        }
+        name += 9;
+        medians[line.substr(name, line.find('"', name) - name)] = atof(line.c_str() + median + 13);
+    }
+    return true;
+}
+
+static bool writeJson(const char *filename, const BenchOptions &options, const std::vector<BenchResult> &results)
+{
+    std::ofstream out(filename);
+    out << std::setprecision(6);
+    out << "{\n";
+    out << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+    out << "  \"simd\": \"" << rasterKernelName() << "\",\n";
+    out << "  \"threads\": " << options.threads << ",\n";
+    out << "  \"cores\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"runs\": " << options.runs << ",\n";
+    out << "  \"triangles\": " << options.triangles << ",\n";
+    out << "  \"distribution\": \"" << distributionName(options.distribution) << "\",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult &r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations << ", \"median_ms\": "
+            << r.medianMs << ", \"p95_ms\": " << r.p95Ms << ", \"min_ms\": " << r.minMs << ", \"pixels_per_s\": "
+            << r.pixelsPerSecond << ", \"triangles_per_s\": " << r.trianglesPerSecond << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return (bool) out;
+}
+
+// Model and TGAImage log every load to std::cerr, which would bury the table
+class QuietLog
+{
+private:
+    std::streambuf *log_;
+
+public:
+    QuietLog() : log_(std::cerr.rdbuf(nullptr))
+    {}
+
+    ~QuietLog()
+    {
+        std::cerr.rdbuf(log_);
+        std::cerr.clear();
+    }
+};
+
+static std::unique_ptr<Model> loadQuietly(const char *filename, int flags)
+{
+    QuietLog quiet;
+    return std::unique_ptr<Model>(new Model(filename, flags));
+}
+
+static void addRasterBenchmarks(const TriangleSet &set, TGAImage &image, std::vector<Benchmark> &benchmarks)
+{
+    const TriangleSet *s = &set;
+    TGAImage *target = &image;
+    double ntriangles = set.points.size() / 3;
+    benchmarks.push_back(Benchmark{"triangle/" + set.name, [s, target]() {
+        TGAColor color(255, 255, 255, 255);
+        for (size_t i = 0; i < s->points.size(); i += 3)
+        {
+            Vec2i pts[3];
+            for (int k = 0; k < 3; k++)
+            {
+                pts[k] = Vec2i((int) s->points[i + k].x, (int) s->points[i + k].y);
+            }
+            triangle(pts, *target, color);
+        }
+    }, set.pixels, ntriangles});
+    benchmarks.push_back(Benchmark{"edge/" + set.name, [s, target]() {
+        TGAColor color(255, 255, 255, 255);
+        for (size_t i = 0; i < s->points.size(); i += 3)
+        {
+            triangleEdge(&s->points[i], *target, color);
+        }
+    }, set.pixels, ntriangles});
+
+    // one line along the first edge of every triangle
+    double linePixels = 0;
+    for (size_t i = 0; i < set.points.size(); i += 3)
+    {
+        int dx = std::abs((int) set.points[i + 1].x - (int) set.points[i].x);
+        int dy = std::abs((int) set.points[i + 1].y - (int) set.points[i].y);
+        linePixels += std::max(dx, dy) + 1;
+    }
+    benchmarks.push_back(Benchmark{"line/" + set.name, [s, target]() {
+        TGAColor color(255, 255, 255, 255);
+        int w = target->get_width();
+        int h = target->get_height();
+        for (size_t i = 0; i < s->points.size(); i += 3)
+        {
+            Vec2i p0((int) s->points[i].x, (int) s->points[i].y);
+            Vec2i p1((int) s->points[i + 1].x, (int) s->points[i + 1].y);
+            drawLine(p0, p1, *target, color, 0, 0, w - 1, h - 1);
+        }
+    }, linePixels, 0});
+}
+
+static void printResult(const BenchResult &r, const std::map<std::string, double> &baseline, double threshold,
+                        int &regressions)
+{
+    std::cout << std::left << std::setw(44) << r.name << std::right << std::setw(8) << r.iterations << std::fixed
+              << std::setprecision(4) << std::setw(12) << r.medianMs << std::setw(12) << r.p95Ms
+              << std::setprecision(1) << std::setw(10) << r.pixelsPerSecond / 1e6 << std::setw(10)
+              << r.trianglesPerSecond / 1e3;
+    auto old = baseline.find(r.name);
+    if (old != baseline.end() && old->second > 0)
+    {
+        double ratio = r.medianMs / old->second;
+        std::cout << std::setprecision(3) << std::setw(9) << ratio << "x";
+        if (ratio > 1 + threshold)
+        {
+            std::cout << " slower";
+            regressions++;
+        }
+    }
+    std::cout << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        return 1;
+    }
+    std::map<std::string, double> baseline;
+    if (options.baselinePath && !readBaseline(options.baselinePath, baseline))
+    {
+        std::cerr << "can't read baseline " << options.baselinePath << "\n";
+        return 1;
+    }
+    ThreadPool pool(options.threads);
+    options.threads = pool.size();
+    std::unique_ptr<Model> head = loadQuietly(options.modelPath, MODEL_CACHE);
+    if (!head->good())
+    {
+        std::cerr << "can't load " << options.modelPath << "\n";
+        return 1;
+    }
+    std::string modelName = options.modelPath;
+    modelName = modelName.substr(modelName.find_last_of('/') + 1);
+    modelName = modelName.substr(0, modelName.find('.'));
+
+    std::vector<TriangleSet> sets;
+    std::vector<std::unique_ptr<Model> > meshes;
+    std::vector<std::string> meshNames;
+    for (size_t i = 0; i < options.sizes.size(); i++)
+    {
+        unsigned seed = BENCH_SEED + (unsigned) i;
+        TriangleSet mesh = makeTriangleSet(options.triangles, options.sizes[i], options.distribution, seed);
+        std::string filename = "bench/synthetic-" + mesh.name + "-" + std::to_string(options.triangles) + ".obj";
+        if (!writeSyntheticObj(mesh, filename, seed))
+        {
+            std::cerr << "can't write " << filename << "\n";
+            return 1;
+        }
+        meshes.push_back(loadQuietly(filename.c_str(), 0));
+        meshNames.push_back(filename);
+        double area = std::sqrt(3.) / 4 * options.sizes[i] * options.sizes[i];
+        int count = (int) std::max(64., std::min((double) options.triangles, RASTER_SET_PIXELS / area));
+        sets.push_back(makeTriangleSet(count, options.sizes[i], options.distribution, seed));
+    }
+
+    TGAImage canvas(BENCH_WIDTH, BENCH_HEIGHT, TGAImage::RGB);
+    std::vector<Benchmark> benchmarks;
+    for (size_t i = 0; i < sets.size(); i++)
+    {
+        addRasterBenchmarks(sets[i], canvas, benchmarks);
+    }
+
+    // a 5 x 5 block of pixel tests around the center of each of the smallest triangles
+    std::vector<Vec2i> corners;
+    for (size_t i = 0; i < sets[0].points.size() && corners.size() < 3 * 4096; i++)
+    {
+        corners.push_back(Vec2i((int) sets[0].points[i].x, (int) sets[0].points[i].y));
+    }
+    volatile float probeSink = 0;
+    benchmarks.push_back(Benchmark{"barycentric", [&corners, &probeSink]() {
+        float sum = 0;
+        for (size_t i = 0; i < corners.size(); i += 3)
+        {
+            Vec2i center = (corners[i] + corners[i + 1] + corners[i + 2]) * (1.f / 3);
+            for (int dy = -2; dy <= 2; dy++)
+            {
+                for (int dx = -2; dx <= 2; dx++)
+                {
+                    sum += barycentric(&corners[i], Vec2i(center.x + dx, center.y + dy)).x;
+                }
+            }
+        }
+        probeSink = sum;
+    }, corners.size() / 3 * 25., 0});
+
+    std::string headPath = options.modelPath;
+    benchmarks.push_back(Benchmark{"model_load/" + modelName + "-cached", [&headPath]() {
+        loadQuietly(headPath.c_str(), MODEL_CACHE);
+    }, 0, (double) head->nfaces()});
+    benchmarks.push_back(Benchmark{"model_load/" + modelName + "-parse", [&headPath]() {
+        loadQuietly(headPath.c_str(), 0);
+    }, 0, (double) head->nfaces()});
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const std::string *path = &meshNames[i];
+        benchmarks.push_back(Benchmark{"model_load/synthetic-" + sets[i].name + "-parse", [path]() {
+            loadQuietly(path->c_str(), 0);
+        }, 0, (double) meshes[i]->nfaces()});
+    }
+
+    // whole frames, render only, then render and write as main does
+    double framePixels = (double) BENCH_WIDTH * BENCH_HEIGHT;
+    FrameRenderer renderer(&pool);
+    TGAImage frame(BENCH_WIDTH, BENCH_HEIGHT, TGAImage::RGB);
+    const char *modeNames[] = {"barycentric", "edge", "wireframe"};
+    for (int mode = RASTER_BARYCENTRIC; mode <= RASTER_WIREFRAME; mode++)
+    {
+        RenderSettings settings;
+        settings.raster = (RasterMode) mode;
+        benchmarks.push_back(Benchmark{"frame/" + modelName + "-" + modeNames[mode], [&, settings]() {
+            frame.clear();
+            renderer.render(*head, settings, frame);
+        }, framePixels, (double) head->nfaces()});
+    }
+    RenderSettings msaa;
+    msaa.samples = 4;
+    benchmarks.push_back(Benchmark{"frame/" + modelName + "-edge-msaa4", [&, msaa]() {
+        frame.clear();
+        renderer.render(*head, msaa, frame);
+    }, framePixels, (double) head->nfaces()});
+    const char *shadingNames[] = {"flat", "gouraud", "phong"};
+    for (int shading = SHADING_GOURAUD; shading <= SHADING_PHONG; shading++)
+    {
+        RenderSettings settings;
+        settings.shading = (ShadingMode) shading;
+        benchmarks.push_back(Benchmark{"frame/" + modelName + "-edge-" + shadingNames[shading], [&, settings]() {
+            frame.clear();
+            renderer.render(*head, settings, frame);
+        }, framePixels, (double) head->nfaces()});
+    }
+    // relighting: the visibility pass once, then a resolve per light
+    benchmarks.push_back(Benchmark{"frame/" + modelName + "-visibility", [&]() {
+        renderer.renderVisibility(*head, RenderSettings(), BENCH_WIDTH, BENCH_HEIGHT);
+    }, framePixels, (double) head->nfaces()});
+    FrameRenderer relighter(&pool);
+    relighter.renderVisibility(*head, RenderSettings(), BENCH_WIDTH, BENCH_HEIGHT);
+    for (int shading = SHADING_FLAT; shading <= SHADING_PHONG; shading++)
+    {
+        RenderSettings settings;
+        settings.shading = (ShadingMode) shading;
+        settings.light = Vec3f(1, 1, 1);
+        benchmarks.push_back(Benchmark{"frame/" + modelName + "-resolve-" + shadingNames[shading], [&, settings]() {
+            frame.clear();
+            relighter.resolve(settings, frame);
+        }, framePixels, (double) head->nfaces()});
+    }
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const Model *mesh = meshes[i].get();
+        benchmarks.push_back(Benchmark{"frame/synthetic-" + sets[i].name + "-edge", [&, mesh]() {
+            frame.clear();
+            renderer.render(*mesh, RenderSettings(), frame);
+        }, framePixels, (double) mesh->nfaces()});
+    }
+    benchmarks.push_back(Benchmark{"draw_triangles/" + modelName, [&]() {
+        frame.clear();
+        renderer.render(*head, RenderSettings(), frame);
+        write_tga_file(frame.view().flipped_vertically(), "bench/output.tga", true, &pool);
+    }, framePixels, (double) head->nfaces()});
+
+    // file round trips of a rendered frame
+    frame.clear();
+    renderer.render(*head, RenderSettings(), frame);
+    TGAImage loaded;
+    const char *encodings[] = {"raw", "rle"};
+    for (int rle = 0; rle < 2; rle++)
+    {
+        std::string filename = std::string("bench/frame-") + encodings[rle] + ".tga";
+        benchmarks.push_back(Benchmark{std::string("tga_write/") + encodings[rle], [&, filename, rle]() {
+            frame.write_tga_file(filename.c_str(), rle != 0);
+        }, framePixels, 0});
+        benchmarks.push_back(Benchmark{std::string("tga_read/") + encodings[rle], [&, filename]() {
+            QuietLog quiet;
+            loaded.read_tga_file(filename.c_str());
+        }, framePixels, 0});
+    }
+
+    std::cout << std::left << std::setw(44) << "# benchmark" << std::right << std::setw(8) << "iters" << std::setw(12)
+              << "median_ms" << std::setw(12) << "p95_ms" << std::setw(10) << "Mpix/s" << std::setw(10) << "Ktri/s"
+              << (baseline.empty() ? "" : "  vs base") << "\n";
+    std::vector<BenchResult> results;
+    int regressions = 0;
+    for (size_t i = 0; i < benchmarks.size(); i++)
+    {
+        if (options.filter && benchmarks[i].name.find(options.filter) == std::string::npos)
+        {
+            continue;
+        }
+        results.push_back(measure(benchmarks[i], options));
+        printResult(results.back(), baseline, options.threshold, regressions);
+    }
+    if (options.jsonPath && !writeJson(options.jsonPath, options, results))
+    {
+        std::cerr << "can't write " << options.jsonPath << "\n";
+        return 1;
+    }
+    if (regressions)
+    {
+        std::cerr << regressions << " benchmark(s) more than " << options.threshold * 100
+                  << "% slower than the baseline\n";
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#ifndef __BOUNDEDQUEUE_H__
+#define __BOUNDEDQUEUE_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Blocking FIFO between pipeline stages. push() waits while the queue holds capacity items,
+// which keeps a fast producer from running ahead of its consumer. After close() pushes are
+// dropped and pop() returns false once the remaining items are drained.
+template<class T>
+class BoundedQueue
+{
+private:
+    std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_;
+
+public:
+    explicit BoundedQueue(size_t capacity) : mutex_(), notFull_(), notEmpty_(), items_(), capacity_(capacity),
+                                             closed_(false)
+    {}
+
+    BoundedQueue(const BoundedQueue &) = delete;
+
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_)
+        {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty())
+        {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+};
+
+#endif //__BOUNDEDQUEUE_H__
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include "depthbuffer.h"
+
+DepthBuffer::DepthBuffer(int w, int h, DepthFormat format) : format_(format), width_(w), height_(h), scale_(1.f),
+                                                             floats_(), ints_(), shorts_(), blocksX_(0), blocksY_(0),
+                                                             tilesX_(0), blockMin_(), blockMax_(), blockDirty_(),
+                                                             tileMin_(), tileDirty_()
+{
+    unsigned long npixels = (unsigned long) w * h;
+    switch (format)
+    {
+        case DEPTH_FLOAT:
+            floats_.resize(npixels);
+            break;
+        case DEPTH_24:
+            scale_ = (float) ((1 << 24) - 1);
+            ints_.resize(npixels);
+            break;
+        case DEPTH_16:
+            scale_ = (float) ((1 << 16) - 1);
+            shorts_.resize(npixels);
+            break;
+        default:
+            break;
+    }
+    blocksX_ = (w + HIZ_BLOCK - 1) / HIZ_BLOCK;
+    blocksY_ = (h + HIZ_BLOCK - 1) / HIZ_BLOCK;
+    tilesX_ = (w + HIZ_TILE - 1) / HIZ_TILE;
+    int tilesY = (h + HIZ_TILE - 1) / HIZ_TILE;
+    blockMin_.resize(blocksX_ * blocksY_);
+    blockMax_.resize(blocksX_ * blocksY_);
+    blockDirty_.resize(blocksX_ * blocksY_);
+    tileMin_.resize(tilesX_ * tilesY);
+    tileDirty_.resize(tilesX_ * tilesY);
+    clear();
+}
+
+DepthFormat DepthBuffer::format() const
+{
+    return format_;
+}
+
+int DepthBuffer::get_width() const
+{
+    return width_;
+}
+
+int DepthBuffer::get_height() const
+{
+    return height_;
+}
+
+float *DepthBuffer::floats()
+{
+    return floats_.data();
+}
+
+unsigned int *DepthBuffer::ints()
+{
+    return ints_.data();
+}
+
+unsigned short *DepthBuffer::shorts()
+{
+    return shorts_.data();
+}
+
+float DepthBuffer::get_scale() const
+{
+    return scale_;
+}
+
+float DepthBuffer::quantize(float z) const
+{
+    if (format_ == DEPTH_FLOAT)
+    {
+        return z;
+    }
+    z = std::min(1.f, std::max(0.f, z));
+    return (float) (unsigned int) (z * scale_ + .5f);
+}
+
+void DepthBuffer::clear()
+{
+    std::fill(floats_.begin(), floats_.end(), 0.f);
+    std::fill(ints_.begin(), ints_.end(), 0u);
+    std::fill(shorts_.begin(), shorts_.end(), (unsigned short) 0);
+    std::fill(blockMin_.begin(), blockMin_.end(), 0.f);
+    std::fill(blockMax_.begin(), blockMax_.end(), 0.f);
+    std::fill(blockDirty_.begin(), blockDirty_.end(), 0);
+    std::fill(tileMin_.begin(), tileMin_.end(), 0.f);
+    std::fill(tileDirty_.begin(), tileDirty_.end(), 0);
+}
+
+float DepthBuffer::stored(int x, int y) const
+{
+    unsigned long i = (unsigned long) y * width_ + x;
+    switch (format_)
+    {
+        case DEPTH_FLOAT:
+            return floats_[i];
+        case DEPTH_24:
+            return (float) ints_[i];
+        case DEPTH_16:
+            return (float) shorts_[i];
+        default:
+            return 0.f;
+    }
+}
+
+void DepthBuffer::touch(int bx, int by)
+{
+    blockDirty_[by * blocksX_ + bx] = 1;
+    tileDirty_[(by * HIZ_BLOCK / HIZ_TILE) * tilesX_ + bx * HIZ_BLOCK / HIZ_TILE] = 1;
+}
+
+void DepthBuffer::refreshBlock(int bx, int by)
+{
+    int b = by * blocksX_ + bx;
+    if (!blockDirty_[b])
+    {
+        return;
+    }
+    int x1 = std::min(width_, (bx + 1) * HIZ_BLOCK);
+    int y1 = std::min(height_, (by + 1) * HIZ_BLOCK);
+    float lo = stored(bx * HIZ_BLOCK, by * HIZ_BLOCK);
+    float hi = lo;
+    for (int y = by * HIZ_BLOCK; y < y1; y++)
+    {
+        for (int x = bx * HIZ_BLOCK; x < x1; x++)
+        {
+            float v = stored(x, y);
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+        }
+    }
+    blockMin_[b] = lo;
+    blockMax_[b] = hi;
+    blockDirty_[b] = 0;
+}
+
+void DepthBuffer::refreshTile(int tx, int ty)
+{
+    int t = ty * tilesX_ + tx;
+    if (!tileDirty_[t])
+    {
+        return;
+    }
+    const int per = HIZ_TILE / HIZ_BLOCK;
+    int bx1 = std::min(blocksX_, (tx + 1) * per);
+    int by1 = std::min(blocksY_, (ty + 1) * per);
+    float lo = blockMin(tx * per, ty * per);
+    for (int by = ty * per; by < by1; by++)
+    {
+        for (int bx = tx * per; bx < bx1; bx++)
+        {
+            lo = std::min(lo, blockMin(bx, by));
+        }
+    }
+    tileMin_[t] = lo;
+    tileDirty_[t] = 0;
+}
+
+float DepthBuffer::blockMin(int bx, int by)
+{
+    refreshBlock(bx, by);
+    return blockMin_[by * blocksX_ + bx];
+}
+
+float DepthBuffer::blockMax(int bx, int by)
+{
+    refreshBlock(bx, by);
+    return blockMax_[by * blocksX_ + bx];
+}
+
+bool DepthBuffer::occluded(float q, int x0, int y0, int x1, int y1)
+{
+    // whole tiles first, they are one lookup each
+    bool hidden = true;
+    for (int ty = y0 / HIZ_TILE; hidden && ty <= y1 / HIZ_TILE; ty++)
+    {
+        for (int tx = x0 / HIZ_TILE; hidden && tx <= x1 / HIZ_TILE; tx++)
+        {
+            refreshTile(tx, ty);
+            hidden = q <= tileMin_[ty * tilesX_ + tx];
+        }
+    }
+    if (hidden)
+    {
+        return true;
+    }
+    // a tile that is only partly overlapped may still be hidden over the rectangle itself
+    for (int by = y0 / HIZ_BLOCK; by <= y1 / HIZ_BLOCK; by++)
+    {
+        for (int bx = x0 / HIZ_BLOCK; bx <= x1 / HIZ_BLOCK; bx++)
+        {
+            if (q > blockMin(bx, by))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
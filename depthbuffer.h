@@ -0,0 +1,80 @@
+#ifndef __DEPTHBUFFER_H__
+#define __DEPTHBUFFER_H__
+
+#include <vector>
+
+enum DepthFormat
+{
+    DEPTH_NONE, DEPTH_FLOAT, DEPTH_24, DEPTH_16
+};
+
+const int HIZ_BLOCK = 8;
+const int HIZ_TILE = 64;
+
+// Depth values lie in [0, 1], larger values are closer to the viewer and a fragment passes
+// if it is strictly closer than the stored value. Integer formats store round(z * (2^bits - 1)).
+// On top of the per-pixel values the buffer keeps the min/max of every HIZ_BLOCK square and
+// the min of every HIZ_TILE square, refreshed lazily after writes, so occluded triangles can
+// be rejected a block or a tile at a time. Callers touching disjoint HIZ_TILE squares may use
+// the buffer from different threads.
+class DepthBuffer
+{
+private:
+    DepthFormat format_;
+    int width_;
+    int height_;
+    float scale_;
+    std::vector<float> floats_;
+    std::vector<unsigned int> ints_;
+    std::vector<unsigned short> shorts_;
+    int blocksX_;
+    int blocksY_;
+    int tilesX_;
+    std::vector<float> blockMin_;
+    std::vector<float> blockMax_;
+    std::vector<unsigned char> blockDirty_;
+    std::vector<float> tileMin_;
+    std::vector<unsigned char> tileDirty_;
+
+    float stored(int x, int y) const;
+
+    void refreshBlock(int bx, int by);
+
+    void refreshTile(int tx, int ty);
+
+public:
+    DepthBuffer(int w, int h, DepthFormat format);
+
+    DepthFormat format() const;
+
+    int get_width() const;
+
+    int get_height() const;
+
+    float *floats();
+
+    unsigned int *ints();
+
+    unsigned short *shorts();
+
+    // 1 for DEPTH_FLOAT, 2^bits - 1 for the integer formats
+    float get_scale() const;
+
+    // z in the units of the stored values
+    float quantize(float z) const;
+
+    void clear();
+
+    // records that a pixel of block (bx, by) has been written
+    void touch(int bx, int by);
+
+    float blockMin(int bx, int by);
+
+    float blockMax(int bx, int by);
+
+    // true if every pixel of [x0, x1] x [y0, y1] already holds a value at least as close as
+    // the quantized depth q
+    bool occluded(float q, int x0, int y0, int x1, int y1);
+};
+
+#endif //__DEPTHBUFFER_H__
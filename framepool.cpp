@@ -0,0 +1,108 @@
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+#include "framepool.h"
+
+static size_t hugeSize(size_t nbytes)
+{
+    return (nbytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+unsigned char *allocatePixels(size_t nbytes, bool hugePages)
+{
+    if (hugePages && nbytes >= HUGE_PAGE_SIZE)
+    {
+        // map one huge page more than needed and cut the range down to an aligned one
+        size_t size = hugeSize(nbytes);
+        void *p = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+        uintptr_t begin = (uintptr_t) p;
+        uintptr_t aligned = (begin + HUGE_PAGE_SIZE - 1) & ~(uintptr_t) (HUGE_PAGE_SIZE - 1);
+        if (aligned > begin)
+        {
+            munmap(p, aligned - begin);
+        }
+        munmap((void *) (aligned + size), begin + HUGE_PAGE_SIZE - aligned);
+#ifdef MADV_HUGEPAGE
+        madvise((void *) aligned, size, MADV_HUGEPAGE);
+#endif
+        return (unsigned char *) aligned;
+    }
+    void *p = nullptr;
+    if (posix_memalign(&p, PIXEL_ALIGNMENT, nbytes ? nbytes : 1))
+    {
+        throw std::bad_alloc();
+    }
+    return (unsigned char *) p;
+}
+
+void freePixels(unsigned char *pixels, size_t nbytes, bool hugePages)
+{
+    if (!pixels)
+    {
+        return;
+    }
+    if (hugePages && nbytes >= HUGE_PAGE_SIZE)
+    {
+        munmap(pixels, hugeSize(nbytes));
+    } else
+    {
+        free(pixels);
+    }
+}
+
+FramePool::FramePool(bool hugePages) : mutex_(), free_(), hugePages_(hugePages), allocations_(0)
+{}
+
+FramePool::~FramePool()
+{
+    trim();
+}
+
+unsigned char *FramePool::acquire(size_t nbytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<unsigned char *> &buffers = free_[nbytes];
+        if (!buffers.empty())
+        {
+            unsigned char *pixels = buffers.back();
+            buffers.pop_back();
+            return pixels;
+        }
+        allocations_++;
+    }
+    return allocatePixels(nbytes, hugePages_);
+}
+
+void FramePool::release(unsigned char *pixels, size_t nbytes)
+{
+    if (pixels)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_[nbytes].push_back(pixels);
+    }
+}
+
+void FramePool::trim()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::map<size_t, std::vector<unsigned char *> >::iterator it = free_.begin(); it != free_.end(); ++it)
+    {
+        for (size_t i = 0; i < it->second.size(); i++)
+        {
+            freePixels(it->second[i], it->first, hugePages_);
+        }
+    }
+    free_.clear();
+}
+
+int FramePool::allocations()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return allocations_;
+}
@@ -0,0 +1,55 @@
+#ifndef __FRAMEPOOL_H__
+#define __FRAMEPOOL_H__
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Pixel buffers start on a cache line, so rows of SIMD-friendly widths never straddle one
+// needlessly and separate images never share a line.
+const size_t PIXEL_ALIGNMENT = 64;
+
+// Huge pages are requested for buffers of at least this size.
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+// With hugePages large buffers are mapped on HUGE_PAGE_SIZE boundaries and marked for
+// transparent huge pages, which cuts TLB misses when whole frames are streamed through;
+// everything else comes from the heap, PIXEL_ALIGNMENT aligned.
+unsigned char *allocatePixels(size_t nbytes, bool hugePages);
+
+void freePixels(unsigned char *pixels, size_t nbytes, bool hugePages);
+
+// Keeps the buffers of released images for the next image of the same size, so rendering
+// frame after frame at one resolution allocates nothing once the pool has warmed up. Images
+// borrow from it through TGAImage(w, h, bpp, pool) and give the buffer back when they are
+// destroyed, so they must not outlive the pool. Safe to share between threads.
+class FramePool
+{
+private:
+    std::mutex mutex_;
+    std::map<size_t, std::vector<unsigned char *> > free_; // by size in bytes
+    bool hugePages_;
+    int allocations_;
+
+    FramePool(const FramePool &);
+
+    FramePool &operator=(const FramePool &);
+
+public:
+    explicit FramePool(bool hugePages = false);
+
+    ~FramePool();
+
+    unsigned char *acquire(size_t nbytes);
+
+    void release(unsigned char *pixels, size_t nbytes);
+
+    // frees every buffer not currently borrowed
+    void trim();
+
+    // buffers allocated over the lifetime of the pool
+    int allocations();
+};
+
+#endif //__FRAMEPOOL_H__
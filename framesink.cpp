@@ -0,0 +1,146 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits.h>
+#include <unistd.h>
+#include "framesink.h"
+#include "renderstats.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+FrameSink::FrameSink(int fd, FrameFormat format) : fd_(fd), format_(format), buffer_(), rows_()
+{}
+
+FrameFormat FrameSink::format() const
+{
+    return format_;
+}
+
+bool FrameSink::write(const ImageView &view)
+{
+    if (!view.origin)
+    {
+        return false;
+    }
+    StageTimer timer(STAGE_WRITE);
+    bool ok = format_ == FRAME_RAW && view.pixelStride > 0 ? writeRaw(view) : writeConverted(view);
+    if (!ok)
+    {
+        std::cerr << "can't write frame: " << strerror(errno) << "\n";
+    }
+    return ok;
+}
+
+// Pipes may take less than asked for, so the vectors are advanced past whatever got written.
+bool FrameSink::writeRaw(const ImageView &view)
+{
+    int height = view.height;
+    size_t bytesPerLine = (size_t) view.width * view.bytespp;
+    rows_.resize(height);
+    for (int j = 0; j < height; j++)
+    {
+        rows_[j].iov_base = view.pixel(0, j);
+        rows_[j].iov_len = bytesPerLine;
+    }
+    struct iovec *iov = rows_.data();
+    int count = height;
+    while (count > 0)
+    {
+        ssize_t n = writev(fd_, iov, count < IOV_MAX ? count : IOV_MAX);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        while (count > 0 && (size_t) n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    countStat(BYTES_WRITTEN, (long long) bytesPerLine * height);
+    return true;
+}
+
+bool FrameSink::writeConverted(const ImageView &view)
+{
+    int width = view.width;
+    int height = view.height;
+    int bytespp = view.bytespp;
+    int depth = format_ == FRAME_PPM && bytespp == TGAImage::RGBA ? 3 : bytespp;
+    char header[128];
+    int headerSize = 0;
+    if (format_ == FRAME_PPM)
+    {
+        headerSize = snprintf(header, sizeof(header), "P%d\n%d %d\n255\n", depth == 1 ? 5 : 6, width, height);
+    } else if (format_ == FRAME_PAM)
+    {
+        const char *tupleType = depth == 1 ? "GRAYSCALE" : (depth == 3 ? "RGB" : "RGB_ALPHA");
+        headerSize = snprintf(header, sizeof(header),
+                              "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n", width, height,
+                              depth, tupleType);
+    }
+    buffer_.resize(headerSize + (size_t) width * height * depth);
+    memcpy(buffer_.data(), header, headerSize);
+    unsigned char *out = buffer_.data() + headerSize;
+    for (int j = 0; j < height; j++)
+    {
+        const unsigned char *in = view.pixel(0, j);
+        if (format_ == FRAME_RAW || depth == 1)
+        {
+            // no reordering within a pixel, only raw frames that are mirrored go pixel by pixel
+            if (view.pixelStride > 0)
+            {
+                memcpy(out, in, (size_t) width * depth);
+                out += (size_t) width * depth;
+                continue;
+            }
+            for (int i = 0; i < width; i++, in += view.pixelStride, out += depth)
+            {
+                memcpy(out, in, depth);
+            }
+            continue;
+        }
+        // stored as bgr(a), sent as rgb(a)
+        for (int i = 0; i < width; i++, in += view.pixelStride, out += depth)
+        {
+            out[0] = in[2];
+            out[1] = in[1];
+            out[2] = in[0];
+            if (depth == 4)
+            {
+                out[3] = in[3];
+            }
+        }
+    }
+    const unsigned char *p = buffer_.data();
+    size_t left = buffer_.size();
+    while (left > 0)
+    {
+        ssize_t n = ::write(fd_, p, left);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    countStat(BYTES_WRITTEN, (long long) buffer_.size());
+    return true;
+}
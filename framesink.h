@@ -0,0 +1,40 @@
+#ifndef __FRAMESINK_H__
+#define __FRAMESINK_H__
+
+#include <vector>
+#include <sys/uio.h>
+#include "tgaimage.h"
+
+enum FrameFormat
+{
+    FRAME_RAW, // pixels as stored (bgr24, bgra or gray), no header
+    FRAME_PPM, // binary PPM (P6), or PGM (P5) for grayscale; alpha is dropped
+    FRAME_PAM  // PAM (P7) with a GRAYSCALE, RGB or RGB_ALPHA tuple type
+};
+
+// Streams frames back to back into a file descriptor, typically stdout or a pipe into a video
+// encoder. Frames are image views, sent top row first, so a bottom-up image is passed flipped
+// rather than flipped in place. Raw frames go out straight from the image with a single
+// writev(); PPM and PAM frames, and mirrored raw ones, are converted into a buffer kept between
+// frames and sent with a single write().
+class FrameSink
+{
+private:
+    int fd_;
+    FrameFormat format_;
+    std::vector<unsigned char> buffer_;
+    std::vector<struct iovec> rows_;
+
+    bool writeRaw(const ImageView &view);
+
+    bool writeConverted(const ImageView &view);
+
+public:
+    FrameSink(int fd, FrameFormat format);
+
+    FrameFormat format() const;
+
+    bool write(const ImageView &view);
+};
+
+#endif //__FRAMESINK_H__
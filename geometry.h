@@ -2,6 +2,13 @@
 #define __GEOMETRY_H__
 
 #include <cmath>
+#include <ostream>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
 template<class t>
@@ -20,21 +27,27 @@ struct Vec2
         t raw[2];
     };
 
-    Vec2() : u(0), v(0)
+    constexpr Vec2() : u(0), v(0)
     {}
 
-    Vec2(t _u, t _v) : u(_u), v(_v)
+    constexpr Vec2(t _u, t _v) : u(_u), v(_v)
     {}
 
-    inline Vec2<t> operator+(const Vec2<t> &V) const
+    constexpr Vec2<t> operator+(const Vec2<t> &V) const
     { return Vec2<t>(u + V.u, v + V.v); }
 
-    inline Vec2<t> operator-(const Vec2<t> &V) const
+    constexpr Vec2<t> operator-(const Vec2<t> &V) const
     { return Vec2<t>(u - V.u, v - V.v); }
 
-    inline Vec2<t> operator*(float f) const
+    constexpr Vec2<t> operator*(float f) const
     { return Vec2<t>(u * f, v * f); }
 
+    constexpr t &operator[](const int i)
+    { return raw[i]; }
+
+    constexpr const t &operator[](const int i) const
+    { return raw[i]; }
+
     template<class>
     friend std::ostream &operator<<(std::ostream &s, Vec2<t> &v);
 };
@@ -55,27 +68,33 @@ struct Vec3
         t raw[3];
     };
 
-    Vec3() : x(0), y(0), z(0)
+    constexpr Vec3() : x(0), y(0), z(0)
     {}
 
-    Vec3(t _x, t _y, t _z) : x(_x), y(_y), z(_z)
+    constexpr Vec3(t _x, t _y, t _z) : x(_x), y(_y), z(_z)
     {}
 
-    inline Vec3<t> operator^(const Vec3<t> &v) const
+    constexpr Vec3<t> operator^(const Vec3<t> &v) const
     { return Vec3<t>(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x); }
 
-    inline Vec3<t> operator+(const Vec3<t> &v) const
+    constexpr Vec3<t> operator+(const Vec3<t> &v) const
     { return Vec3<t>(x + v.x, y + v.y, z + v.z); }
 
-    inline Vec3<t> operator-(const Vec3<t> &v) const
+    constexpr Vec3<t> operator-(const Vec3<t> &v) const
     { return Vec3<t>(x - v.x, y - v.y, z - v.z); }
 
-    inline Vec3<t> operator*(float f) const
+    constexpr Vec3<t> operator*(float f) const
     { return Vec3<t>(x * f, y * f, z * f); }
 
-    inline t operator*(const Vec3<t> &v) const
+    constexpr t operator*(const Vec3<t> &v) const
     { return x * v.x + y * v.y + z * v.z; }
 
+    constexpr t &operator[](const int i)
+    { return raw[i]; }
+
+    constexpr const t &operator[](const int i) const
+    { return raw[i]; }
+
     float norm() const
     { return std::sqrt(x * x + y * y + z * z); }
 
@@ -94,6 +113,422 @@ typedef Vec2<int> Vec2i;
 typedef Vec3<float> Vec3f;
 typedef Vec3<int> Vec3i;
 
+template<class t>
+constexpr Vec3<t> cross(const Vec3<t> &v1, const Vec3<t> &v2)
+{
+    return v1 ^ v2;
+}
+
+// Homogeneous coordinates; w is 1 for points and 0 for directions.
+template<class t>
+struct Vec4
+{
+    union
+    {
+        struct
+        {
+            t x, y, z, w;
+        };
+        t raw[4];
+    };
+
+    constexpr Vec4() : x(0), y(0), z(0), w(0)
+    {}
+
+    constexpr Vec4(t _x, t _y, t _z, t _w) : x(_x), y(_y), z(_z), w(_w)
+    {}
+
+    constexpr Vec4(const Vec3<t> &v, t _w) : x(v.x), y(v.y), z(v.z), w(_w)
+    {}
+
+    constexpr Vec4<t> operator+(const Vec4<t> &v) const
+    { return Vec4<t>(x + v.x, y + v.y, z + v.z, w + v.w); }
+
+    constexpr Vec4<t> operator-(const Vec4<t> &v) const
+    { return Vec4<t>(x - v.x, y - v.y, z - v.z, w - v.w); }
+
+    constexpr Vec4<t> operator*(float f) const
+    { return Vec4<t>(x * f, y * f, z * f, w * f); }
+
+    constexpr t operator*(const Vec4<t> &v) const
+    { return x * v.x + y * v.y + z * v.z + w * v.w; }
+
+    constexpr t &operator[](const int i)
+    { return raw[i]; }
+
+    constexpr const t &operator[](const int i) const
+    { return raw[i]; }
+
+    constexpr Vec3<t> xyz() const
+    { return Vec3<t>(x, y, z); }
+
+    // the point after the perspective divide
+    constexpr Vec3<t> project() const
+    { return Vec3<t>(x / w, y / w, z / w); }
+};
+
+typedef Vec4<float> Vec4f;
+
+// Row-major 3x3 matrix acting on column vectors, for directions and normals.
+struct Mat3f
+{
+    float m[3][3];
+
+    constexpr Mat3f() : m()
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            m[i][i] = 1.f;
+        }
+    }
+
+    constexpr float *operator[](const int i)
+    { return m[i]; }
+
+    constexpr const float *operator[](const int i) const
+    { return m[i]; }
+
+    constexpr Mat3f operator*(const Mat3f &b) const
+    {
+        Mat3f r;
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                r.m[i][j] = m[i][0] * b.m[0][j] + m[i][1] * b.m[1][j] + m[i][2] * b.m[2][j];
+            }
+        }
+        return r;
+    }
+
+    constexpr Vec3f operator*(const Vec3f &v) const
+    {
+        return Vec3f(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z, m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                     m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+    }
+
+    constexpr Mat3f transposed() const
+    {
+        Mat3f r;
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                r.m[i][j] = m[j][i];
+            }
+        }
+        return r;
+    }
+
+    constexpr float determinant() const
+    {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+               m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+
+    // the matrix of cofactors divided by the determinant, which must not be 0
+    constexpr Mat3f inverse() const
+    {
+        Mat3f r;
+        float d = determinant();
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                int i0 = (j + 1) % 3;
+                int i1 = (j + 2) % 3;
+                int j0 = (i + 1) % 3;
+                int j1 = (i + 2) % 3;
+                r.m[i][j] = (m[i0][j0] * m[i1][j1] - m[i0][j1] * m[i1][j0]) / d;
+            }
+        }
+        return r;
+    }
+};
+
+// Row-major 4x4 matrix acting on column vectors: p' = M * (x, y, z, 1).
+struct Mat4f
+{
+    float m[4][4];
+
+    constexpr Mat4f() : m()
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            m[i][i] = 1.f;
+        }
+    }
+
+    constexpr float *operator[](const int i)
+    { return m[i]; }
+
+    constexpr const float *operator[](const int i) const
+    { return m[i]; }
+
+    constexpr Mat4f operator*(const Mat4f &b) const
+    {
+        Mat4f r;
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                r.m[i][j] = m[i][0] * b.m[0][j] + m[i][1] * b.m[1][j] + m[i][2] * b.m[2][j] + m[i][3] * b.m[3][j];
+            }
+        }
+        return r;
+    }
+
+    constexpr Vec4f operator*(const Vec4f &v) const
+    {
+        return Vec4f(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z + m[0][3] * v.w,
+                     m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z + m[1][3] * v.w,
+                     m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z + m[2][3] * v.w,
+                     m[3][0] * v.x + m[3][1] * v.y + m[3][2] * v.z + m[3][3] * v.w);
+    }
+
+    constexpr Mat3f upper3x3() const
+    {
+        Mat3f r;
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                r.m[i][j] = m[i][j];
+            }
+        }
+        return r;
+    }
+};
+
+// Transforms normals along with model: the inverse transpose of its linear part, which keeps
+// them perpendicular to surfaces under non-uniform scaling. The result is not normalized.
+constexpr Mat3f normalMatrix(const Mat4f &model)
+{
+    return model.upper3x3().inverse().transposed();
+}
+
+// Maps normalized device coordinates [-1, 1]^3 to pixels [x, x + w] x [y, y + h] and depth [0, 1].
+constexpr Mat4f viewport(int x, int y, int w, int h)
+{
+    Mat4f r;
+    r[0][0] = w / 2.f;
+    r[0][3] = x + w / 2.f;
+    r[1][1] = h / 2.f;
+    r[1][3] = y + h / 2.f;
+    r[2][2] = .5f;
+    r[2][3] = .5f;
+    return r;
+}
+
+// World to view space: the eye moves to the origin, looking down -z with up along +y.
+inline Mat4f lookAt(const Vec3f &eye, const Vec3f &center, const Vec3f &up)
+{
+    Vec3f z = (eye - center).normalize();
+    Vec3f x = cross(up, z).normalize();
+    Vec3f y = cross(z, x);
+    Mat4f r;
+    for (int i = 0; i < 3; i++)
+    {
+        r[0][i] = x[i];
+        r[1][i] = y[i];
+        r[2][i] = z[i];
+    }
+    r[0][3] = -(x * eye);
+    r[1][3] = -(y * eye);
+    r[2][3] = -(z * eye);
+    return r;
+}
+
+// The projections map view space to normalized device coordinates with z = 1 on the near
+// plane and z = -1 on the far one, so that larger depth is closer, as the depth buffer expects.
+
+// Parallel projection of the box halfHeight * aspect by halfHeight around the view axis,
+// between view distances zNear and zFar.
+constexpr Mat4f orthographic(float halfHeight, float aspect, float zNear, float zFar)
+{
+    Mat4f r;
+    r[0][0] = 1.f / (halfHeight * aspect);
+    r[1][1] = 1.f / halfHeight;
+    r[2][2] = 2.f / (zFar - zNear);
+    r[2][3] = (zFar + zNear) / (zFar - zNear);
+    return r;
+}
+
+// fovy is the vertical field of view in radians.
+inline Mat4f perspective(float fovy, float aspect, float zNear, float zFar)
+{
+    float f = 1.f / std::tan(fovy / 2);
+    Mat4f r;
+    r[0][0] = f / aspect;
+    r[1][1] = f;
+    r[2][2] = (zFar + zNear) / (zFar - zNear);
+    r[2][3] = 2.f * zFar * zNear / (zFar - zNear);
+    r[3][2] = -1.f;
+    r[3][3] = 0.f;
+    return r;
+}
+
+// Floats processed side by side: eight in an AVX register or four in an SSE one, depending on
+// the flags the including file is compiled with, and a single one without either.
+struct FloatPack
+{
+#if defined(__AVX__)
+    static const int LANES = 8;
+    __m256 v;
+
+    FloatPack(__m256 _v) : v(_v)
+    {}
+
+    explicit FloatPack(float f) : v(_mm256_set1_ps(f))
+    {}
+
+    static FloatPack load(const float *p)
+    { return _mm256_loadu_ps(p); }
+
+    void store(float *p) const
+    { _mm256_storeu_ps(p, v); }
+
+    FloatPack operator+(const FloatPack &b) const
+    { return _mm256_add_ps(v, b.v); }
+
+    FloatPack operator-(const FloatPack &b) const
+    { return _mm256_sub_ps(v, b.v); }
+
+    FloatPack operator*(const FloatPack &b) const
+    { return _mm256_mul_ps(v, b.v); }
+
+    FloatPack operator/(const FloatPack &b) const
+    { return _mm256_div_ps(v, b.v); }
+
+    FloatPack sqrt() const
+    { return _mm256_sqrt_ps(v); }
+#elif defined(__SSE2__)
+    static const int LANES = 4;
+    __m128 v;
+
+    FloatPack(__m128 _v) : v(_v)
+    {}
+
+    explicit FloatPack(float f) : v(_mm_set1_ps(f))
+    {}
+
+    static FloatPack load(const float *p)
+    { return _mm_loadu_ps(p); }
+
+    void store(float *p) const
+    { _mm_storeu_ps(p, v); }
+
+    FloatPack operator+(const FloatPack &b) const
+    { return _mm_add_ps(v, b.v); }
+
+    FloatPack operator-(const FloatPack &b) const
+    { return _mm_sub_ps(v, b.v); }
+
+    FloatPack operator*(const FloatPack &b) const
+    { return _mm_mul_ps(v, b.v); }
+
+    FloatPack operator/(const FloatPack &b) const
+    { return _mm_div_ps(v, b.v); }
+
+    FloatPack sqrt() const
+    { return _mm_sqrt_ps(v); }
+#else
+    static const int LANES = 1;
+    float v;
+
+    explicit FloatPack(float f) : v(f)
+    {}
+
+    static FloatPack load(const float *p)
+    { return FloatPack(*p); }
+
+    void store(float *p) const
+    { *p = v; }
+
+    FloatPack operator+(const FloatPack &b) const
+    { return FloatPack(v + b.v); }
+
+    FloatPack operator-(const FloatPack &b) const
+    { return FloatPack(v - b.v); }
+
+    FloatPack operator*(const FloatPack &b) const
+    { return FloatPack(v * b.v); }
+
+    FloatPack operator/(const FloatPack &b) const
+    { return FloatPack(v / b.v); }
+
+    FloatPack sqrt() const
+    { return FloatPack(std::sqrt(v)); }
+#endif
+};
+
+// FloatPack::LANES vectors in structure-of-arrays form: lane i of x, y and z is vector i. The
+// operations round exactly like their Vec3f counterparts lane by lane.
+struct Vec3Pack
+{
+    FloatPack x;
+    FloatPack y;
+    FloatPack z;
+
+    Vec3Pack(const FloatPack &_x, const FloatPack &_y, const FloatPack &_z) : x(_x), y(_y), z(_z)
+    {}
+
+    // v in every lane
+    explicit Vec3Pack(const Vec3f &v) : x(v.x), y(v.y), z(v.z)
+    {}
+
+    // LANES consecutive vectors stored one array per coordinate
+    static Vec3Pack load(const float *xs, const float *ys, const float *zs)
+    { return Vec3Pack(FloatPack::load(xs), FloatPack::load(ys), FloatPack::load(zs)); }
+
+    // lane i is points[indices[i * stride]]
+    static Vec3Pack gather(const Vec3f *points, const int *indices, int stride = 1)
+    {
+        float c[3][FloatPack::LANES];
+        for (int i = 0; i < FloatPack::LANES; i++)
+        {
+            const Vec3f &p = points[indices[i * stride]];
+            c[0][i] = p.x;
+            c[1][i] = p.y;
+            c[2][i] = p.z;
+        }
+        return load(c[0], c[1], c[2]);
+    }
+
+    void store(float *xs, float *ys, float *zs) const
+    {
+        x.store(xs);
+        y.store(ys);
+        z.store(zs);
+    }
+
+    Vec3Pack operator+(const Vec3Pack &v) const
+    { return Vec3Pack(x + v.x, y + v.y, z + v.z); }
+
+    Vec3Pack operator-(const Vec3Pack &v) const
+    { return Vec3Pack(x - v.x, y - v.y, z - v.z); }
+
+    Vec3Pack operator*(const FloatPack &f) const
+    { return Vec3Pack(x * f, y * f, z * f); }
+
+    FloatPack operator*(const Vec3Pack &v) const
+    { return x * v.x + y * v.y + z * v.z; }
+
+    Vec3Pack operator^(const Vec3Pack &v) const
+    { return Vec3Pack(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x); }
+
+    FloatPack norm() const
+    { return (x * x + y * y + z * z).sqrt(); }
+
+    Vec3Pack normalized() const
+    { return *this * (FloatPack(1.f) / norm()); }
+};
+
+inline Vec3Pack cross(const Vec3Pack &v1, const Vec3Pack &v2)
+{
+    return v1 ^ v2;
+}
+
 template<class t>
 std::ostream &operator<<(std::ostream &s, Vec2<t> &v)
 {
@@ -1,8 +1,24 @@
 #include <vector>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "batch.h"
+#include "depthbuffer.h"
+#include "framepool.h"
+#include "framesink.h"
 #include "geometry.h"
 #include "tgaimage.h"
 #include "model.h"
+#include "rasterizer.h"
+#include "renderer.h"
+#include "renderstats.h"
+#include "sequence.h"
+#include "texture.h"
+#include "threadpool.h"
+#include "transform.h"
 
 const TGAColor white = TGAColor(255, 255, 255, 255);
 const TGAColor red = TGAColor(255, 0, 0, 255);
@@ -11,161 +27,448 @@ Model *model = nullptr;
 const int width = 800;
 const int height = 800;
 
-Vec3f barycentric(Vec2i *pts, Vec2i p)
+struct Options
 {
-    Vec3f u = cross(Vec3f(pts[2][0] - pts[0][0], pts[1][0] - pts[0][0], pts[0][0] - p[0]),
-                    Vec3f(pts[2][1] - pts[0][1], pts[1][1] - pts[0][1], pts[0][1] - p[1]));
-    if (std::abs(u[2]) < 1)
+    const char *modelPath;
+    RasterMode raster;
+    int threads;
+    DepthFormat depth;
+    int samples;
+    ShadingMode shading;
+    bool meshCache;
+    bool optimizeMesh;
+    const char *batchPath;
+    const char *summaryPath;
+    const char *outputPath; // a frame name pattern in sequence mode
+    int frames;             // 0 renders a single image
+    int width;
+    int height;
+    Camera camera;
+    bool hugePages;
+    bool stream; // frames go to streamFd instead of TGA files
+    FrameFormat streamFormat;
+    int streamFd;
+    const char *texturePath;
+    const Texture *texture; // loaded from texturePath
+    std::vector<Vec3f> lights; // more than one relights a visibility buffer
+    const char *statsPath;
+    bool overdraw;
+    std::string overdrawPath; // next to the output unless given
+
+    Options() : modelPath("obj/african_head.obj"), raster(RASTER_EDGE), threads(0), depth(DEPTH_FLOAT), samples(1),
+                shading(SHADING_FLAT), meshCache(true), optimizeMesh(false), batchPath(nullptr),
+                summaryPath("batch_summary.tsv"), outputPath(nullptr), frames(0), width(::width), height(::height),
+                camera(), hugePages(false), stream(false), streamFormat(FRAME_RAW), streamFd(1), texturePath(nullptr),
+                texture(nullptr), lights(), statsPath(nullptr), overdraw(false), overdrawPath()
+    {}
+};
+
+bool parseRasterKernel(const char *name, RasterKernel &kernel)
+{
+    const char *names[] = {"auto", "scalar", "sse2", "avx2"};
+    const RasterKernel kernels[] = {KERNEL_AUTO, KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2};
+    for (int i = 0; i < 4; i++)
     {
-        return Vec3f(-1, 1, 1);
+        if (!strcmp(name, names[i]))
+        {
+            kernel = kernels[i];
+            return true;
+        }
     }
-    return Vec3f(1.f - (u.x + u.y) / u.z, u.y / u.z, u.x / u.z);
+    return false;
 }
 
-void line(Vec2i p0, Vec2i p1, TGAImage &image, TGAColor color)
+bool parseDepthFormat(const char *name, DepthFormat &format)
 {
-    bool steep = false;
-    if (std::abs(p0.x - p1.x) < std::abs(p0.y - p1.y))
-    {
-        std::swap(p0.x, p0.y);
-        std::swap(p1.x, p1.y);
-        steep = true;
-    }
-    if (p0.x > p1.x)
-    {
-        std::swap(p0.x, p1.x);
-        std::swap(p0.y, p1.y);
-    }
-    int dx = p1.x - p0.x;
-    int dy = p1.y - p0.y;
-    int derror2 = std::abs(dy) * 2;
-    int error2 = 0;
-    int y = p0.y;
-    for (int x = p0.x; x <= p1.x; x++)
+    const char *names[] = {"none", "float", "24", "16"};
+    const DepthFormat formats[] = {DEPTH_NONE, DEPTH_FLOAT, DEPTH_24, DEPTH_16};
+    for (int i = 0; i < 4; i++)
     {
-        if (steep)
-        {
-            image.set(y, x, color);
-        }
-        else
+        if (!strcmp(name, names[i]))
         {
-            image.set(x, y, color);
+            format = formats[i];
+            return true;
         }
-        error2 += derror2;
-        if (error2 > dx)
+    }
+    return false;
+}
+
+bool parseShadingMode(const char *name, ShadingMode &mode)
+{
+    const char *names[] = {"flat", "gouraud", "phong"};
+    const ShadingMode modes[] = {SHADING_FLAT, SHADING_GOURAUD, SHADING_PHONG};
+    for (int i = 0; i < 3; i++)
+    {
+        if (!strcmp(name, names[i]))
         {
-            y += (p1.y > p0.y ? 1 : -1);
-            error2 -= dx * 2;
+            mode = modes[i];
+            return true;
         }
     }
+    return false;
 }
 
-void triangle(Vec2i *pts, TGAImage &image, TGAColor color)
+bool parseFrameFormat(const char *name, FrameFormat &format)
 {
-    Vec2i bboxmin(image.get_width() - 1, image.get_height() - 1);
-    Vec2i bboxmax(0, 0);
-    Vec2i clamp(image.get_width() - 1, image.get_height() - 1);
+    const char *names[] = {"raw", "ppm", "pam"};
+    const FrameFormat formats[] = {FRAME_RAW, FRAME_PPM, FRAME_PAM};
     for (int i = 0; i < 3; i++)
     {
-        for (int j = 0; j < 2; j++)
+        if (!strcmp(name, names[i]))
         {
-            bboxmin[j] = std::max(0, std::min(bboxmin[j], pts[i][j]));
-            bboxmax[j] = std::min(clamp[j], std::max(bboxmax[j], pts[i][j]));
+            format = formats[i];
+            return true;
         }
     }
-    Vec2i p;
-    for (p.x = bboxmin.x; p.x <= bboxmax.x; p.x++)
+    return false;
+}
+
+bool parseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
     {
-        for (p.y = bboxmin.y; p.y <= bboxmax.y; p.y++)
+        const char *arg = argv[i];
+        if (!strcmp(arg, "--raster=barycentric"))
+        {
+            options.raster = RASTER_BARYCENTRIC;
+        } else if (!strcmp(arg, "--raster=edge"))
+        {
+            options.raster = RASTER_EDGE;
+        } else if (!strcmp(arg, "--raster=wireframe"))
+        {
+            options.raster = RASTER_WIREFRAME;
+        } else if (!strcmp(arg, "--no-mesh-cache"))
+        {
+            options.meshCache = false;
+        } else if (!strcmp(arg, "--optimize-mesh"))
+        {
+            options.optimizeMesh = true;
+        } else if (!strcmp(arg, "--huge-pages"))
+        {
+            options.hugePages = true;
+        } else if (!strncmp(arg, "--depth=", 8))
+        {
+            if (!parseDepthFormat(arg + 8, options.depth))
+            {
+                std::cerr << "unknown depth format " << arg + 8 << "\n";
+                return false;
+            }
+        } else if (!strncmp(arg, "--shading=", 10))
+        {
+            if (!parseShadingMode(arg + 10, options.shading))
+            {
+                std::cerr << "unknown shading mode " << arg + 10 << "\n";
+                return false;
+            }
+        } else if (!strncmp(arg, "--msaa=", 7))
+        {
+            if (!parseSampleCount(arg + 7, options.samples))
+            {
+                std::cerr << "unsupported sample count " << arg + 7 << "\n";
+                return false;
+            }
+        } else if (!strncmp(arg, "--batch=", 8))
+        {
+            options.batchPath = arg + 8;
+        } else if (!strncmp(arg, "--summary=", 10))
+        {
+            options.summaryPath = arg + 10;
+        } else if (!strncmp(arg, "--output=", 9))
+        {
+            options.outputPath = arg + 9;
+        } else if (!strncmp(arg, "--frames=", 9))
+        {
+            options.frames = atoi(arg + 9);
+            if (options.frames <= 0)
+            {
+                std::cerr << "bad frame count " << arg + 9 << "\n";
+                return false;
+            }
+        } else if (!strncmp(arg, "--stream=", 9))
+        {
+            options.stream = true;
+            if (!parseFrameFormat(arg + 9, options.streamFormat))
+            {
+                std::cerr << "unknown stream format " << arg + 9 << "\n";
+                return false;
+            }
+        } else if (!strncmp(arg, "--stream-fd=", 12))
+        {
+            options.stream = true;
+            options.streamFd = atoi(arg + 12);
+        } else if (!strncmp(arg, "--texture=", 10))
         {
-            Vec3f bcScreen = barycentric(pts, p);
-            if (bcScreen.x < 0 || bcScreen.y < 0 || bcScreen.z < 0)
+            options.texturePath = arg + 10;
+        } else if (!strncmp(arg, "--light=", 8))
+        {
+            Vec3f light;
+            if (!parseVec3(arg + 8, light) || !(light.norm() > 0))
             {
-                continue;
+                std::cerr << "bad light direction " << arg + 8 << "\n";
+                return false;
             }
-            image.set(p.x, p.y, color);
+            options.lights.push_back(light);
+        } else if (!strncmp(arg, "--stats=", 8))
+        {
+            options.statsPath = arg + 8;
+        } else if (!strcmp(arg, "--overdraw"))
+        {
+            options.overdraw = true;
+        } else if (!strncmp(arg, "--overdraw=", 11))
+        {
+            options.overdraw = true;
+            options.overdrawPath = arg + 11;
+        } else if (!strncmp(arg, "--threads=", 10))
+        {
+            options.threads = atoi(arg + 10);
+        } else if (!strncmp(arg, "--simd=", 7))
+        {
+            RasterKernel kernel;
+            if (!parseRasterKernel(arg + 7, kernel) || !selectRasterKernel(kernel))
+            {
+                std::cerr << "unsupported simd kernel " << arg + 7 << "\n";
+                return false;
+            }
+        } else if (arg[0] == '-')
+        {
+            // --size=WxH and the camera settings read the same as in a batch manifest
+            if (strncmp(arg, "--", 2) || !parseViewSetting(arg + 2, options.width, options.height, options.camera))
+            {
+                std::cerr << "unknown option or bad value " << arg << "\n";
+                return false;
+            }
+        } else
+        {
+            options.modelPath = arg;
         }
     }
-}
-
-int drawWireframe(int argc, char **argv)
-{
-    if (argc == 2)
+    if (options.camera.degenerate())
     {
-        model = new Model(argv[1]);
+        std::cerr << "degenerate camera\n";
+        return false;
     }
-    else
+    if (options.samples > 1 && options.raster != RASTER_EDGE)
     {
-        model = new Model("obj/african_head.obj");
+        std::cerr << "multisampling needs the edge rasterizer\n";
+        return false;
     }
-
-    TGAImage image(width, height, TGAImage::RGB);
-    for (int i = 0; i < model->nfaces(); i++)
-    {
-        std::vector<int> face = model->face(i);
-        for (int j = 0; j < 3; j++)
-        {
-            Vec3f v0 = model->vert(face[j]);
-            Vec3f v1 = model->vert(face[(j + 1) % 3]);
-            Vec2i p0;
-            Vec2i p1;
-            p0.x = static_cast<int>((v0.x + 1.) * width / 2.);
-            p0.y = static_cast<int>((v0.y + 1.) * height / 2.);
-            p1.x = static_cast<int>((v1.x + 1.) * width / 2.);
-            p1.y = static_cast<int>((v1.y + 1.) * height / 2.);
-            line(p0, p1, image, white);
+    if (options.texturePath && (options.raster != RASTER_EDGE || options.samples > 1))
+    {
+        std::cerr << "textures need the edge rasterizer without multisampling\n";
+        return false;
+    }
+    if (options.shading != SHADING_FLAT && (options.raster != RASTER_EDGE || options.samples > 1))
+    {
+        std::cerr << "gouraud and phong shading need the edge rasterizer without multisampling\n";
+        return false;
+    }
+    if (options.stream && options.batchPath)
+    {
+        std::cerr << "batch mode writes files, it can't stream\n";
+        return false;
+    }
+    if (options.lights.size() > 1 && (options.batchPath || options.frames))
+    {
+        std::cerr << "several lights relight a single view, not a batch or a sequence\n";
+        return false;
+    }
+    if (options.lights.size() > 1 && (options.raster != RASTER_EDGE || options.samples > 1))
+    {
+        std::cerr << "relighting needs the edge rasterizer without multisampling\n";
+        return false;
+    }
+    if ((options.frames || options.lights.size() > 1) && options.outputPath &&
+        !validFramePattern(options.outputPath))
+    {
+        std::cerr << "output pattern needs exactly one %d\n";
+        return false;
+    }
+    if ((options.statsPath || options.overdraw) && !RENDER_STATS_ENABLED)
+    {
+        std::cerr << "built without pipeline statistics\n";
+        return false;
+    }
+    if (options.overdraw && (options.batchPath || options.frames || options.lights.size() > 1))
+    {
+        std::cerr << "overdraw is only counted for a single image\n";
+        return false;
+    }
+    if (options.overdraw && options.overdrawPath.empty())
+    {
+        if (options.stream)
+        {
+            std::cerr << "a streamed image needs --overdraw=FILE\n";
+            return false;
+        }
+        // output.tga gets output.overdraw.tga
+        std::string output = options.outputPath ? options.outputPath : "output.tga";
+        size_t dot = output.rfind('.');
+        if (dot != std::string::npos && output.find('/', dot) == std::string::npos)
+        {
+            output.erase(dot);
         }
+        options.overdrawPath = output + ".overdraw.tga";
     }
+    return true;
+}
 
+int modelFlags(const Options &options)
+{
+    return (options.meshCache ? MODEL_CACHE : 0) | (options.optimizeMesh ? MODEL_OPTIMIZE : 0);
+}
 
-    image.flip_vertically();
-    image.write_tga_file("output.tga");
+RenderSettings renderSettings(const Options &options)
+{
+    RenderSettings settings;
+    settings.raster = options.raster;
+    settings.depth = options.depth;
+    settings.samples = options.samples;
+    settings.shading = options.shading;
+    settings.camera = options.camera;
+    settings.texture = options.texture;
+    if (!options.lights.empty())
+    {
+        settings.light = options.lights[0];
+    }
+    return settings;
+}
+
+int drawTriangles(const Options &options)
+{
+    model = new Model(options.modelPath, modelFlags(options));
+    if (!model->good())
+    {
+        delete model;
+        return 1;
+    }
+    FramePool frames(options.hugePages);
+    TGAImage image(options.width, options.height, TGAImage::RGB, &frames);
+    if (options.overdraw)
+    {
+        enableOverdraw(options.width, options.height);
+    }
+    ThreadPool pool(options.threads);
+    FrameRenderer renderer(&pool);
+    renderer.render(*model, renderSettings(options), image);
+    bool written;
+    if (options.stream)
+    {
+        FrameSink sink(options.streamFd, options.streamFormat);
+        written = sink.write(image.view().flipped_vertically());
+    } else
+    {
+        written = write_tga_file(image.view().flipped_vertically(),
+                                 options.outputPath ? options.outputPath : "output.tga", true, &pool);
+    }
     delete model;
-    return 0;
+    return written ? 0 : 1;
 }
 
-int drawTriangles(int argc, char **argv)
+int drawSequence(const Options &options)
 {
-    if (argc == 2)
+    model = new Model(options.modelPath, modelFlags(options));
+    if (!model->good())
     {
-        model = new Model(argv[1]);
+        delete model;
+        return 1;
     }
-    else
+    ThreadPool pool(options.threads);
+    FramePool frames(options.hugePages);
+    FrameSink sink(options.streamFd, options.streamFormat);
+    int failed = renderSequence(*model, renderSettings(options), options.width, options.height, options.frames,
+                                options.outputPath ? options.outputPath : "frame%04d.tga",
+                                options.stream ? &sink : nullptr, pool, frames);
+    delete model;
+    return failed ? 1 : 0;
+}
+
+int drawLights(const Options &options)
+{
+    model = new Model(options.modelPath, modelFlags(options));
+    if (!model->good())
     {
-        model = new Model("obj/african_head.obj");
+        delete model;
+        return 1;
     }
-    TGAImage image(width, height, TGAImage::RGB);
-    Vec3f lightDir(0, 0, -1);
-    for (int i = 0; i < model->nfaces(); i++)
+    FramePool frames(options.hugePages);
+    TGAImage image(options.width, options.height, TGAImage::RGB, &frames);
+    ThreadPool pool(options.threads);
+    FrameRenderer renderer(&pool);
+    RenderSettings settings = renderSettings(options);
+    renderer.renderVisibility(*model, settings, options.width, options.height);
+    FrameSink sink(options.streamFd, options.streamFormat);
+    const char *pattern = options.outputPath ? options.outputPath : "light%02d.tga";
+    std::vector<char> filename(strlen(pattern) + 32);
+    int failed = 0;
+    for (size_t i = 0; i < options.lights.size(); i++)
     {
-        std::vector<int> face = model->face(i);
-        Vec2i screenCoords[3];
-        Vec3f worldCoords[3];
-        for (int j = 0; j < 3; j++)
+        settings.light = options.lights[i];
+        image.clear();
+        renderer.resolve(settings, image);
+        bool written;
+        if (options.stream)
         {
-            Vec3f v = model->vert(face[j]);
-            screenCoords[j] = Vec2i((v.x + 1.0) * width / 2.0, (v.y + 1.0) * height / 2.0);
-            worldCoords[j] = v;
-        }
-        Vec3f base = worldCoords[2] - worldCoords[0];
-        Vec3f exponent = worldCoords[1] - worldCoords[0];
-        Vec3f n = Vec3f(base.y * exponent.z - base.z * exponent.y,
-                        base.z * exponent.x - base.x * exponent.z,
-                        base.x * exponent.y - base.y * exponent.x);
-        n.normalize();
-        float intensity = n.x * lightDir.x + n.y * lightDir.y + n.z * lightDir.z;
-        if (intensity > 0)
-        {
-            Vec2i pts[3] = {Vec2i(screenCoords[0]), Vec2i(screenCoords[1]), Vec2i(screenCoords[2])};
-            triangle(pts, image, TGAColor(intensity * 255, intensity * 255, intensity * 255, 255));
+            written = sink.write(image.view().flipped_vertically());
+        } else
+        {
+            snprintf(filename.data(), filename.size(), pattern, (int) i);
+            written = write_tga_file(image.view().flipped_vertically(), filename.data(), true, &pool);
         }
+        failed += !written;
+    }
+    delete model;
+    return failed ? 1 : 0;
+}
+
+int drawBatch(const Options &options)
+{
+    std::vector<BatchJob> jobs;
+    std::string error;
+    if (!readManifest(options.batchPath, jobs, error))
+    {
+        std::cerr << options.batchPath << ": " << error << "\n";
+        return 1;
     }
-    image.flip_vertically();
-    image.write_tga_file("output.tga");
-    return 0;
+    ThreadPool pool(options.threads);
+    FramePool frames(options.hugePages);
+    return runBatch(jobs, renderSettings(options), modelFlags(options), pool, frames, options.summaryPath) ? 1 : 0;
 }
 
 int main(int argc, char **argv)
 {
-    return drawTriangles(argc, argv);
-}
\ No newline at end of file
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        return 1;
+    }
+    Texture texture;
+    if (options.texturePath)
+    {
+        if (!texture.load(options.texturePath))
+        {
+            return 1;
+        }
+        options.texture = &texture;
+    }
+    int status;
+    if (options.batchPath)
+    {
+        status = drawBatch(options);
+    } else if (options.frames)
+    {
+        status = drawSequence(options);
+    } else
+    {
+        status = options.lights.size() > 1 ? drawLights(options) : drawTriangles(options);
+    }
+    // the statistics go first, so they leave out the overdraw image
+    if (options.statsPath && !writeStatsJson(options.statsPath))
+    {
+        status = 1;
+    }
+    if (options.overdraw && !writeOverdrawImage(options.overdrawPath.c_str()))
+    {
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mappedfile.h"
+
+MappedFile::MappedFile() : data_(nullptr), size_(0), mapped_(false)
+{}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *filename)
+{
+    close();
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            data_ = (const char *) p;
+            size_ = st.st_size;
+            mapped_ = true;
+            ::close(fd);
+            return true;
+        }
+    }
+    size_t capacity = 1 << 16;
+    char *buffer = new char[capacity];
+    for (;;)
+    {
+        if (size_ == capacity)
+        {
+            char *grown = new char[capacity * 2];
+            std::copy(buffer, buffer + size_, grown);
+            delete[] buffer;
+            buffer = grown;
+            capacity *= 2;
+        }
+        ssize_t n = read(fd, buffer + size_, capacity - size_);
+        if (n < 0)
+        {
+            delete[] buffer;
+            size_ = 0;
+            ::close(fd);
+            return false;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        size_ += n;
+    }
+    data_ = buffer;
+    ::close(fd);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_)
+    {
+        if (mapped_)
+        {
+            munmap((void *) data_, size_);
+        } else
+        {
+            delete[] data_;
+        }
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+}
+
+const char *MappedFile::data() const
+{
+    return data_;
+}
+
+size_t MappedFile::size() const
+{
+    return size_;
+}
@@ -0,0 +1,33 @@
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include <cstddef>
+
+// Read-only view of a whole file. The file is memory-mapped where possible; empty files and
+// files that can't be mapped (pipes, some network mounts) are read into a heap buffer instead.
+class MappedFile
+{
+private:
+    const char *data_;
+    size_t size_;
+    bool mapped_;
+
+    MappedFile(const MappedFile &);
+
+    MappedFile &operator=(const MappedFile &);
+
+public:
+    MappedFile();
+
+    ~MappedFile();
+
+    bool open(const char *filename);
+
+    void close();
+
+    const char *data() const;
+
+    size_t size() const;
+};
+
+#endif //__MAPPEDFILE_H__
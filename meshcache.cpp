@@ -0,0 +1,170 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "mappedfile.h"
+#include "meshcache.h"
+
+const char MESH_CACHE_MAGIC[8] = {'S', 'R', 'M', 'E', 'S', 'H', '\0', '\0'};
+const unsigned int MESH_CACHE_VERSION = 3;
+const unsigned int MESH_CACHE_ENDIAN = 0x01020304;
+const int MESH_CACHE_ARRAYS = 7;
+const unsigned int MESH_CACHE_OPTIMIZED = 1;
+
+struct MeshCacheHeader
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int endian;
+    unsigned int flags;
+    unsigned int reserved;
+    long long sourceSize;
+    long long sourceMtime;
+    // verts, uvs, normals, vertIndices, uvIndices, normalIndices, faceStart
+    unsigned long long counts[MESH_CACHE_ARRAYS];
+    unsigned long long payloadSize;
+    unsigned long long checksum;
+};
+
+static const size_t elementSizes[MESH_CACHE_ARRAYS] = {sizeof(Vec3f), sizeof(Vec2f), sizeof(Vec3f), sizeof(int),
+                                                       sizeof(int), sizeof(int), sizeof(int)};
+
+static inline size_t padded(size_t n)
+{
+    return (n + 7) & ~(size_t) 7;
+}
+
+// 64-bit multiply-rotate hash over 8-byte words; fast enough to check on every load.
+static unsigned long long checksum(const char *data, size_t size)
+{
+    unsigned long long h = 0x9e3779b97f4a7c15ULL ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        unsigned long long word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ word) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    for (; i < size; i++)
+    {
+        h = (h ^ (unsigned char) data[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+bool statFile(const char *filename, FileStamp &stamp)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0)
+    {
+        return false;
+    }
+    stamp.size = st.st_size;
+    stamp.mtime = (long long) st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+}
+
+template<class T>
+static void readArray(const char *&p, unsigned long long count, std::vector<T> &out)
+{
+    out.resize(count);
+    memcpy((void *) out.data(), p, count * sizeof(T));
+    p += padded(count * sizeof(T));
+}
+
+bool readMeshCache(const char *filename, const FileStamp &source, MeshData &mesh)
+{
+    MappedFile file;
+    if (!file.open(filename) || file.size() < sizeof(MeshCacheHeader))
+    {
+        return false;
+    }
+    MeshCacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) || header.version != MESH_CACHE_VERSION ||
+        header.endian != MESH_CACHE_ENDIAN || header.sourceSize != source.size || header.sourceMtime != source.mtime)
+    {
+        return false;
+    }
+    unsigned long long expected = 0;
+    for (int i = 0; i < MESH_CACHE_ARRAYS; i++)
+    {
+        if (header.counts[i] > file.size() / elementSizes[i])
+        {
+            return false;
+        }
+        expected += padded(header.counts[i] * elementSizes[i]);
+    }
+    const char *payload = file.data() + sizeof(header);
+    if (header.payloadSize != expected || file.size() - sizeof(header) != expected ||
+        header.checksum != checksum(payload, expected))
+    {
+        return false;
+    }
+    readArray(payload, header.counts[0], mesh.verts);
+    readArray(payload, header.counts[1], mesh.uvs);
+    readArray(payload, header.counts[2], mesh.normals);
+    readArray(payload, header.counts[3], mesh.vertIndices);
+    readArray(payload, header.counts[4], mesh.uvIndices);
+    readArray(payload, header.counts[5], mesh.normalIndices);
+    readArray(payload, header.counts[6], mesh.faceStart);
+    mesh.optimized = (header.flags & MESH_CACHE_OPTIMIZED) != 0;
+    return true;
+}
+
+template<class T>
+static void appendArray(std::string &payload, const std::vector<T> &in)
+{
+    payload.append((const char *) in.data(), in.size() * sizeof(T));
+    payload.resize(padded(payload.size()), '\0');
+}
+
+bool writeMeshCache(const char *filename, const FileStamp &source, const MeshData &mesh)
+{
+    std::string payload;
+    appendArray(payload, mesh.verts);
+    appendArray(payload, mesh.uvs);
+    appendArray(payload, mesh.normals);
+    appendArray(payload, mesh.vertIndices);
+    appendArray(payload, mesh.uvIndices);
+    appendArray(payload, mesh.normalIndices);
+    appendArray(payload, mesh.faceStart);
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.endian = MESH_CACHE_ENDIAN;
+    header.flags = mesh.optimized ? MESH_CACHE_OPTIMIZED : 0;
+    header.sourceSize = source.size;
+    header.sourceMtime = source.mtime;
+    header.counts[0] = mesh.verts.size();
+    header.counts[1] = mesh.uvs.size();
+    header.counts[2] = mesh.normals.size();
+    header.counts[3] = mesh.vertIndices.size();
+    header.counts[4] = mesh.uvIndices.size();
+    header.counts[5] = mesh.normalIndices.size();
+    header.counts[6] = mesh.faceStart.size();
+    header.payloadSize = payload.size();
+    header.checksum = checksum(payload.data(), payload.size());
+
+    std::string temporary = std::string(filename) + "." + std::to_string(getpid()) + ".tmp";
+    std::ofstream out;
+    out.open(temporary.c_str(), std::ios::binary);
+    if (!out.is_open())
+    {
+        return false;
+    }
+    out.write((const char *) &header, sizeof(header));
+    out.write(payload.data(), payload.size());
+    out.close();
+    if (!out.good() || rename(temporary.c_str(), filename) != 0)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
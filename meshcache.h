@@ -0,0 +1,24 @@
+#ifndef __MESHCACHE_H__
+#define __MESHCACHE_H__
+
+#include "meshdata.h"
+
+// Identifies the version of a source file a cache was built from.
+struct FileStamp
+{
+    long long size;
+    long long mtime; // nanoseconds since the epoch
+};
+
+bool statFile(const char *filename, FileStamp &stamp);
+
+// Binary mesh cache: a versioned header followed by the MeshData arrays back to back, each
+// padded to 8 bytes, and a checksum over everything after the header. A cache only loads
+// if it was written for a source file of the same size and modification time.
+bool readMeshCache(const char *filename, const FileStamp &source, MeshData &mesh);
+
+// Written to a temporary file and renamed into place, so concurrent readers never see a
+// partial cache.
+bool writeMeshCache(const char *filename, const FileStamp &source, const MeshData &mesh);
+
+#endif //__MESHCACHE_H__
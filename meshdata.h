@@ -0,0 +1,37 @@
+#ifndef __MESHDATA_H__
+#define __MESHDATA_H__
+
+#include <vector>
+#include "geometry.h"
+
+// Flat mesh storage shared by the OBJ parser, the mesh cache and Model. Faces are stored back
+// to back as corners: corner c uses vertex vertIndices[c] and, if the mesh has any, texture
+// coordinate uvIndices[c] and normal normalIndices[c] (-1 where the corner leaves one out).
+// faceStart is empty when every face is a triangle, so face i spans corners [3i, 3i + 3);
+// otherwise face i spans [faceStart[i], faceStart[i + 1]). optimized is set once optimizeMesh()
+// has reordered the mesh.
+struct MeshData
+{
+    std::vector<Vec3f> verts;
+    std::vector<Vec2f> uvs;
+    std::vector<Vec3f> normals;
+    std::vector<int> vertIndices;
+    std::vector<int> uvIndices;
+    std::vector<int> normalIndices;
+    std::vector<int> faceStart;
+    bool optimized;
+
+    MeshData() : verts(), uvs(), normals(), vertIndices(), uvIndices(), normalIndices(), faceStart(), optimized(false)
+    {}
+
+    inline int nfaces() const
+    { return faceStart.empty() ? (int) vertIndices.size() / 3 : (int) faceStart.size() - 1; }
+
+    inline int faceBegin(int i) const
+    { return faceStart.empty() ? 3 * i : faceStart[i]; }
+
+    inline int faceEnd(int i) const
+    { return faceStart.empty() ? 3 * i + 3 : faceStart[i + 1]; }
+};
+
+#endif //__MESHDATA_H__
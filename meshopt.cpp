@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cstring>
+#include "meshopt.h"
+
+float computeAcmr(const MeshData &mesh, int cacheSize)
+{
+    int nindices = (int) mesh.vertIndices.size();
+    int ntriangles = nindices - 2 * mesh.nfaces();
+    if (ntriangles <= 0)
+    {
+        return 0.f;
+    }
+    const int *indices = mesh.vertIndices.data();
+    // a vertex is in the FIFO if it was inserted less than cacheSize insertions ago
+    std::vector<long long> inserted(mesh.verts.size(), -(long long) cacheSize);
+    long long time = 0;
+    int misses = 0;
+    for (int i = 0; i < nindices; i++)
+    {
+        int v = indices[i];
+        if (time - inserted[v] >= cacheSize)
+        {
+            inserted[v] = ++time;
+            misses++;
+        }
+    }
+    return (float) misses / ntriangles;
+}
+
+// Maps every element to the first one with the same bytes; returns the number of duplicates.
+template<class T>
+static int weld(const std::vector<T> &items, std::vector<int> &remap)
+{
+    int n = (int) items.size();
+    std::vector<int> order(n);
+    for (int i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        int c = memcmp(&items[a], &items[b], sizeof(T));
+        return c < 0 || (c == 0 && a < b);
+    });
+    remap.resize(n);
+    int duplicates = 0;
+    for (int i = 0; i < n; i++)
+    {
+        bool same = i > 0 && !memcmp(&items[order[i]], &items[order[i - 1]], sizeof(T));
+        remap[order[i]] = same ? remap[order[i - 1]] : order[i];
+        duplicates += same;
+    }
+    return duplicates;
+}
+
+template<class T>
+static int weldAttribute(std::vector<T> &items, std::vector<int> &indices)
+{
+    std::vector<int> remap;
+    int duplicates = weld(items, remap);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        indices[i] = indices[i] < 0 ? indices[i] : remap[indices[i]];
+    }
+    return duplicates;
+}
+
+// Renumbers an attribute in the order its indices first appear; unreferenced items are dropped.
+template<class T>
+static void renumber(std::vector<T> &items, std::vector<int> &indices)
+{
+    std::vector<int> remap(items.size(), -1);
+    std::vector<T> reordered;
+    reordered.reserve(items.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        int v = indices[i];
+        if (v < 0)
+        {
+            continue;
+        }
+        if (remap[v] < 0)
+        {
+            remap[v] = (int) reordered.size();
+            reordered.push_back(items[v]);
+        }
+        indices[i] = remap[v];
+    }
+    items.swap(reordered);
+}
+
+// Next vertex to fan around: the candidate that stays in the cache longest while still having
+// triangles to emit, else the most recent dead end, else the next live vertex in index order.
+static int nextVertex(const std::vector<int> &candidates, const std::vector<int> &live, const std::vector<int> &stamp,
+                      int time, std::vector<int> &deadEnds, int &cursor, int cacheSize)
+{
+    int best = -1;
+    int bestPriority = -1;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        int v = candidates[i];
+        if (live[v] <= 0)
+        {
+            continue;
+        }
+        int priority = 0;
+        if (time - stamp[v] + 2 * live[v] <= cacheSize)
+        {
+            priority = time - stamp[v];
+        }
+        if (priority > bestPriority)
+        {
+            best = v;
+            bestPriority = priority;
+        }
+    }
+    if (best >= 0)
+    {
+        return best;
+    }
+    while (!deadEnds.empty())
+    {
+        int v = deadEnds.back();
+        deadEnds.pop_back();
+        if (live[v] > 0)
+        {
+            return v;
+        }
+    }
+    for (; cursor < (int) live.size(); cursor++)
+    {
+        if (live[cursor] > 0)
+        {
+            return cursor;
+        }
+    }
+    return -1;
+}
+
+// Tipsify (Sander, Nehab, Barczak 2007): returns the triangles in emission order.
+static std::vector<int> tipsify(const std::vector<int> &indices, int nverts, int cacheSize)
+{
+    int ntris = (int) indices.size() / 3;
+    std::vector<int> live(nverts, 0);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        live[indices[i]]++;
+    }
+    std::vector<int> adjacencyStart(nverts + 1, 0);
+    for (int v = 0; v < nverts; v++)
+    {
+        adjacencyStart[v + 1] = adjacencyStart[v] + live[v];
+    }
+    std::vector<int> adjacency(indices.size());
+    std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        adjacency[fill[indices[i]]++] = (int) i / 3;
+    }
+
+    std::vector<int> stamp(nverts, 0);
+    std::vector<char> emitted(ntris, 0);
+    std::vector<int> deadEnds;
+    std::vector<int> candidates;
+    std::vector<int> order;
+    order.reserve(ntris);
+    int time = cacheSize + 1;
+    int cursor = 0;
+    int fan = nverts > 0 ? 0 : -1;
+    while (fan >= 0)
+    {
+        candidates.clear();
+        for (int a = adjacencyStart[fan]; a < adjacencyStart[fan + 1]; a++)
+        {
+            int t = adjacency[a];
+            if (emitted[t])
+            {
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                int v = indices[3 * t + k];
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - stamp[v] > cacheSize)
+                {
+                    stamp[v] = time++;
+                }
+            }
+            emitted[t] = 1;
+            order.push_back(t);
+        }
+        fan = nextVertex(candidates, live, stamp, time, deadEnds, cursor, cacheSize);
+    }
+    return order;
+}
+
+template<class T>
+static void permuteTriangles(std::vector<T> &indices, const std::vector<int> &order)
+{
+    if (indices.empty())
+    {
+        return;
+    }
+    std::vector<T> reordered(indices.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            reordered[3 * i + k] = indices[3 * order[i] + k];
+        }
+    }
+    indices.swap(reordered);
+}
+
+MeshOptStats optimizeMesh(MeshData &mesh)
+{
+    MeshOptStats stats;
+    memset(&stats, 0, sizeof(stats));
+    int nverts = (int) mesh.verts.size();
+    stats.acmrBefore = computeAcmr(mesh);
+    if (mesh.optimized)
+    {
+        stats.acmrAfter = stats.acmrBefore;
+        return stats;
+    }
+    stats.weldedVerts = weldAttribute(mesh.verts, mesh.vertIndices);
+    stats.weldedUvs = weldAttribute(mesh.uvs, mesh.uvIndices);
+    stats.weldedNormals = weldAttribute(mesh.normals, mesh.normalIndices);
+    if (mesh.faceStart.empty())
+    {
+        std::vector<int> order = tipsify(mesh.vertIndices, nverts, VERTEX_CACHE_SIZE);
+        permuteTriangles(mesh.vertIndices, order);
+        permuteTriangles(mesh.uvIndices, order);
+        permuteTriangles(mesh.normalIndices, order);
+    }
+    renumber(mesh.verts, mesh.vertIndices);
+    renumber(mesh.uvs, mesh.uvIndices);
+    renumber(mesh.normals, mesh.normalIndices);
+    mesh.optimized = true;
+    stats.acmrAfter = computeAcmr(mesh);
+    return stats;
+}
@@ -0,0 +1,28 @@
+#ifndef __MESHOPT_H__
+#define __MESHOPT_H__
+
+#include "meshdata.h"
+
+// Size of the FIFO vertex cache that ordering and ACMR figures are computed for.
+const int VERTEX_CACHE_SIZE = 16;
+
+struct MeshOptStats
+{
+    int weldedVerts; // positions removed as duplicates
+    int weldedUvs;
+    int weldedNormals;
+    float acmrBefore; // average cache misses per triangle
+    float acmrAfter;
+};
+
+// Average number of FIFO cache misses per triangle when the faces are drawn in order, with
+// larger faces counted as the triangles of their fan.
+float computeAcmr(const MeshData &mesh, int cacheSize = VERTEX_CACHE_SIZE);
+
+// Welds bitwise-identical positions, texture coordinates and normals, reorders the triangles
+// for post-transform cache locality (Tipsify) and renumbers every attribute in first-use order,
+// dropping unreferenced ones. Meshes with non-triangle faces keep their face order. The result
+// is marked optimized and later calls leave it untouched.
+MeshOptStats optimizeMesh(MeshData &mesh);
+
+#endif //__MESHOPT_H__
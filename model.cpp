@@ -1,62 +1,146 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <string>
 #include <vector>
+#include "mappedfile.h"
+#include "meshcache.h"
+#include "meshopt.h"
 #include "model.h"
+#include "objparser.h"
+#include "renderstats.h"
 
-Model::Model(const char *filename) : verts_(), faces_()
+static bool loadObj(const char *filename, MeshData &mesh)
 {
-    std::ifstream in;
-    in.open(filename, std::ifstream::in);
-    if (in.fail()) return;
-    std::string line;
-    while (!in.eof())
+    MappedFile file;
+    if (!file.open(filename))
     {
-        std::getline(in, line);
-        std::istringstream iss(line.c_str());
-        char trash;
-        if (!line.compare(0, 2, "v "))
+        std::cerr << "can't open file " << filename << "\n";
+        return false;
+    }
+    std::string error;
+    if (!parseObj(file.data(), file.size(), mesh, error))
+    {
+        std::cerr << filename << ": " << error << "\n";
+        return false;
+    }
+    return true;
+}
+
+Model::Model(const char *filename, int flags) : mesh_(), good_(false)
+{
+    StageTimer timer(STAGE_LOAD);
+    FileStamp stamp;
+    bool cache = (flags & MODEL_CACHE) != 0;
+    bool optimize = (flags & MODEL_OPTIMIZE) != 0;
+    std::string cacheName = std::string(filename) + (optimize ? ".opt.mesh" : ".mesh");
+    if (!cache || !statFile(filename, stamp) || !readMeshCache(cacheName.c_str(), stamp, mesh_) ||
+        mesh_.optimized != optimize)
+    {
+        if (!loadObj(filename, mesh_))
+        {
+            mesh_ = MeshData();
+            return;
+        }
+        if (optimize)
         {
-            iss >> trash;
-            Vec3f v;
-            for (int i = 0; i < 3; i++) iss >> v.raw[i];
-            verts_.push_back(v);
-        } else if (!line.compare(0, 2, "f "))
+            MeshOptStats stats = optimizeMesh(mesh_);
+            std::cerr << "# welded v# " << stats.weldedVerts << " vt# " << stats.weldedUvs << " vn# "
+                      << stats.weldedNormals << " acmr " << stats.acmrBefore << " -> " << stats.acmrAfter << "\n";
+        }
+        if (cache && statFile(filename, stamp) && !writeMeshCache(cacheName.c_str(), stamp, mesh_))
         {
-            std::vector<int> f;
-            int itrash, idx;
-            iss >> trash;
-            while (iss >> idx >> trash >> itrash >> trash >> itrash)
-            {
-                idx--; // in wavefront obj all indices start at 1, not zero
-                f.push_back(idx);
-            }
-            faces_.push_back(f);
+            std::cerr << "can't write mesh cache " << cacheName << "\n";
         }
     }
-    std::cerr << "# v# " << verts_.size() << " f# " << faces_.size() << std::endl;
+    good_ = true;
+    std::cerr << "# v# " << nverts() << " f# " << nfaces() << std::endl;
 }
 
 Model::~Model()
 {
 }
 
-int Model::nverts()
+bool Model::good() const
+{
+    return good_;
+}
+
+int Model::nverts() const
+{
+    return (int) mesh_.verts.size();
+}
+
+int Model::nuvs() const
+{
+    return (int) mesh_.uvs.size();
+}
+
+int Model::nnormals() const
+{
+    return (int) mesh_.normals.size();
+}
+
+int Model::nfaces() const
 {
-    return (int) verts_.size();
+    return mesh_.nfaces();
+}
+
+bool Model::triangles() const
+{
+    return mesh_.faceStart.empty();
+}
+
+const Vec3f &Model::vert(int i) const
+{
+    return mesh_.verts[i];
+}
+
+const Vec2f &Model::uv(int i) const
+{
+    return mesh_.uvs[i];
+}
+
+const Vec3f &Model::normal(int i) const
+{
+    return mesh_.normals[i];
+}
+
+Span<int> Model::face(int idx) const
+{
+    int begin = mesh_.faceBegin(idx);
+    return Span<int>(mesh_.vertIndices.data() + begin, mesh_.faceEnd(idx) - begin);
+}
+
+Span<int> Model::faceUvs(int idx) const
+{
+    if (mesh_.uvIndices.empty())
+    {
+        return Span<int>();
+    }
+    int begin = mesh_.faceBegin(idx);
+    return Span<int>(mesh_.uvIndices.data() + begin, mesh_.faceEnd(idx) - begin);
+}
+
+Span<int> Model::faceNormals(int idx) const
+{
+    if (mesh_.normalIndices.empty())
+    {
+        return Span<int>();
+    }
+    int begin = mesh_.faceBegin(idx);
+    return Span<int>(mesh_.normalIndices.data() + begin, mesh_.faceEnd(idx) - begin);
 }
 
-int Model::nfaces()
+const int *Model::indices() const
 {
-    return (int) faces_.size();
+    return mesh_.vertIndices.data();
 }
 
-std::vector<int> Model::face(int idx)
+int Model::nindices() const
 {
-    return faces_[idx];
+    return (int) mesh_.vertIndices.size();
 }
 
-Vec3f Model::vert(int i)
+const MeshData &Model::mesh() const
 {
-    return verts_[i];
+    return mesh_;
 }
@@ -1,26 +1,84 @@
 #ifndef __MODEL_H__
 #define __MODEL_H__
 
-#include <vector>
 #include "geometry.h"
+#include "meshdata.h"
+
+// Read-only view of size consecutive elements owned by someone else.
+template<class t>
+struct Span
+{
+    const t *data;
+    int size;
+
+    Span() : data(nullptr), size(0)
+    {}
+
+    Span(const t *_data, int _size) : data(_data), size(_size)
+    {}
+
+    inline const t &operator[](const int i) const
+    { return data[i]; }
+
+    inline const t *begin() const
+    { return data; }
+
+    inline const t *end() const
+    { return data + size; }
+};
+
+enum ModelFlags
+{
+    MODEL_CACHE = 1, MODEL_OPTIMIZE = 2
+};
 
 class Model
 {
 private:
-    std::vector<Vec3f> verts_;
-    std::vector<std::vector<int> > faces_;
+    MeshData mesh_;
+    bool good_;
 public:
-    Model(const char *filename);
+    // With MODEL_CACHE a binary copy is kept next to the OBJ as <filename>.mesh and used on later
+    // loads for as long as the OBJ keeps its size and modification time. MODEL_OPTIMIZE runs
+    // optimizeMesh() after loading; its result is cached separately as <filename>.opt.mesh.
+    Model(const char *filename, int flags = MODEL_CACHE);
 
     ~Model();
 
-    int nverts();
+    // false if the file could not be read or parsed; the model is then empty
+    bool good() const;
+
+    int nverts() const;
+
+    int nuvs() const;
+
+    int nnormals() const;
+
+    int nfaces() const;
+
+    // true if every face is a triangle, so face i is indices()[3 * i .. 3 * i + 2]
+    bool triangles() const;
+
+    const Vec3f &vert(int i) const;
+
+    const Vec2f &uv(int i) const;
+
+    const Vec3f &normal(int i) const;
+
+    // vertex indices of a face; faces may have more than three corners
+    Span<int> face(int idx) const;
+
+    // texture coordinate / normal indices of a face, empty if the model has none
+    Span<int> faceUvs(int idx) const;
+
+    Span<int> faceNormals(int idx) const;
 
-    int nfaces();
+    // vertex indices of all faces back to back
+    const int *indices() const;
 
-    Vec3f vert(int i);
+    int nindices() const;
 
-    std::vector<int> face(int idx);
+    const MeshData &mesh() const;
 };
 
 #endif //__MODEL_H__
@@ -0,0 +1,473 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "objparser.h"
+#include "threadpool.h"
+
+// inputs below this size per worker are not worth splitting
+const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+// Each chunk keeps faceStart and all three index arrays filled in; parseObj() drops the ones
+// that turn out to be redundant after the merge.
+struct ObjChunk
+{
+    MeshData mesh;
+    std::vector<int> relative; // corner components (corner * 3 + component) given as negative indices
+    const char *begin;
+    const char *end;
+    int lines;
+    int errorLine; // zero-based within the chunk, -1 if the chunk parsed fine
+    std::string error;
+};
+
+static inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline void skipBlanks(const char *&p, const char *end)
+{
+    while (p < end && isBlank(*p))
+    {
+        p++;
+    }
+}
+
+static double powerOfTen(int e)
+{
+    static const double exact[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                   1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    return e <= 22 ? exact[e] : std::pow(10.0, e);
+}
+
+// Decimal floating point number with optional sign, fraction and exponent.
+static bool parseFloat(const char *&p, const char *end, float &value)
+{
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+'))
+    {
+        negative = *s == '-';
+        s++;
+    }
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; s < end && isDigit(*s); s++, any = true)
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*s - '0');
+            digits += mantissa != 0;
+        } else
+        {
+            exponent++;
+        }
+    }
+    if (s < end && *s == '.')
+    {
+        for (s++; s < end && isDigit(*s); s++, any = true)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*s - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (!any)
+    {
+        return false;
+    }
+    if (s < end && (*s == 'e' || *s == 'E'))
+    {
+        s++;
+        bool negativeExponent = false;
+        if (s < end && (*s == '-' || *s == '+'))
+        {
+            negativeExponent = *s == '-';
+            s++;
+        }
+        if (s == end || !isDigit(*s))
+        {
+            return false;
+        }
+        int e = 0;
+        for (; s < end && isDigit(*s); s++)
+        {
+            e = std::min(e * 10 + (*s - '0'), 100000);
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+    double v = (double) mantissa;
+    if (mantissa != 0)
+    {
+        v = exponent < 0 ? v / powerOfTen(-exponent) : v * powerOfTen(exponent);
+    }
+    value = (float) (negative ? -v : v);
+    p = s;
+    return true;
+}
+
+static bool parseInt(const char *&p, const char *end, int &value)
+{
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+'))
+    {
+        negative = *s == '-';
+        s++;
+    }
+    if (s == end || !isDigit(*s))
+    {
+        return false;
+    }
+    long long v = 0;
+    for (; s < end && isDigit(*s); s++)
+    {
+        v = std::min(v * 10 + (*s - '0'), 1LL << 40);
+    }
+    v = negative ? -v : v;
+    if (v < -0x7fffffffLL || v > 0x7fffffffLL)
+    {
+        return false;
+    }
+    value = (int) v;
+    p = s;
+    return true;
+}
+
+static inline bool atSeparator(const char *p, const char *end)
+{
+    return p == end || isBlank(*p) || *p == '\n';
+}
+
+// Reads up to n floats separated by blanks, at least required of them.
+static bool parseFloats(const char *&p, const char *end, float *values, int required, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        skipBlanks(p, end);
+        if (p == end || *p == '\n')
+        {
+            return i >= required;
+        }
+        if (!parseFloat(p, end, values[i]) || !atSeparator(p, end))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Turns an OBJ index (1-based, or negative counting back from the last element so far) into a
+// zero-based index relative to the chunk; negative ones are fixed up once the chunk offsets are known.
+static bool parseIndex(const char *&p, const char *end, int count, int &index, bool &relative)
+{
+    int v;
+    if (!parseInt(p, end, v) || v == 0)
+    {
+        return false;
+    }
+    relative = v < 0;
+    index = relative ? count + v : v - 1;
+    return true;
+}
+
+static bool parseFace(const char *&p, const char *end, ObjChunk &chunk, std::string &error)
+{
+    MeshData &mesh = chunk.mesh;
+    int first = (int) mesh.vertIndices.size();
+    for (;;)
+    {
+        skipBlanks(p, end);
+        if (p == end || *p == '\n')
+        {
+            break;
+        }
+        Vec3i corner(-1, -1, -1);
+        const int counts[3] = {(int) mesh.verts.size(), (int) mesh.uvs.size(), (int) mesh.normals.size()};
+        for (int k = 0; k < 3; k++)
+        {
+            bool relative = false;
+            if (k > 0)
+            {
+                if (p == end || *p != '/')
+                {
+                    break;
+                }
+                p++;
+                // "v//vn" leaves the texture coordinate out
+                if (k == 1 && p < end && *p == '/')
+                {
+                    continue;
+                }
+            }
+            if (!parseIndex(p, end, counts[k], corner.raw[k], relative))
+            {
+                error = "bad face index";
+                return false;
+            }
+            if (relative)
+            {
+                chunk.relative.push_back((int) mesh.vertIndices.size() * 3 + k);
+            }
+        }
+        if (!atSeparator(p, end))
+        {
+            error = "bad face index";
+            return false;
+        }
+        mesh.vertIndices.push_back(corner.ivert);
+        mesh.uvIndices.push_back(corner.iuv);
+        mesh.normalIndices.push_back(corner.inorm);
+    }
+    if ((int) mesh.vertIndices.size() - first < 3)
+    {
+        error = "face with fewer than 3 vertices";
+        return false;
+    }
+    mesh.faceStart.push_back((int) mesh.vertIndices.size());
+    return true;
+}
+
+static bool parseLine(const char *&p, const char *end, ObjChunk &chunk, std::string &error)
+{
+    MeshData &mesh = chunk.mesh;
+    skipBlanks(p, end);
+    if (end - p >= 2 && p[0] == 'v' && isBlank(p[1]))
+    {
+        p += 2;
+        // x y z, optionally followed by w or by an r g b vertex colour
+        float v[6];
+        if (!parseFloats(p, end, v, 3, 6))
+        {
+            error = "bad vertex";
+            return false;
+        }
+        mesh.verts.push_back(Vec3f(v[0], v[1], v[2]));
+    } else if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2]))
+    {
+        p += 3;
+        float v[3] = {0, 0, 0};
+        if (!parseFloats(p, end, v, 1, 3))
+        {
+            error = "bad texture coordinate";
+            return false;
+        }
+        mesh.uvs.push_back(Vec2f(v[0], v[1]));
+    } else if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2]))
+    {
+        p += 3;
+        float v[3];
+        if (!parseFloats(p, end, v, 3, 3))
+        {
+            error = "bad normal";
+            return false;
+        }
+        mesh.normals.push_back(Vec3f(v[0], v[1], v[2]));
+    } else if (end - p >= 2 && p[0] == 'f' && isBlank(p[1]))
+    {
+        p += 2;
+        if (!parseFace(p, end, chunk, error))
+        {
+            return false;
+        }
+    } else
+    {
+        // comments, groups, materials and everything else we don't use
+        while (p < end && *p != '\n')
+        {
+            p++;
+        }
+    }
+    skipBlanks(p, end);
+    if (p < end && *p != '\n')
+    {
+        error = "unexpected trailing characters";
+        return false;
+    }
+    return true;
+}
+
+static void parseChunk(ObjChunk &chunk)
+{
+    chunk.mesh.faceStart.push_back(0);
+    chunk.lines = 0;
+    chunk.errorLine = -1;
+    const char *p = chunk.begin;
+    while (p < chunk.end)
+    {
+        if (!parseLine(p, chunk.end, chunk, chunk.error))
+        {
+            chunk.errorLine = chunk.lines;
+            return;
+        }
+        if (p < chunk.end)
+        {
+            p++; // the newline
+            chunk.lines++;
+        }
+    }
+}
+
+// Line of the n-th face statement, for errors found after the merge.
+static int faceLine(const char *data, size_t size, int face)
+{
+    const char *p = data;
+    const char *end = data + size;
+    int line = 1;
+    while (p < end)
+    {
+        skipBlanks(p, end);
+        if (end - p >= 2 && p[0] == 'f' && isBlank(p[1]) && face-- == 0)
+        {
+            return line;
+        }
+        while (p < end && *p != '\n')
+        {
+            p++;
+        }
+        p++;
+        line++;
+    }
+    return line;
+}
+
+static bool allAbsent(const std::vector<int> &indices)
+{
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        if (indices[i] != -1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseObj(const char *data, size_t size, MeshData &mesh, std::string &error)
+{
+    mesh = MeshData();
+    int nchunks = (int) std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                         size / MIN_CHUNK_BYTES + 1);
+    std::vector<ObjChunk> chunks(nchunks);
+    const char *end = data + size;
+    const char *begin = data;
+    for (int i = 0; i < nchunks; i++)
+    {
+        const char *split = i + 1 == nchunks ? end : data + (size_t) ((double) size * (i + 1) / nchunks);
+        split = std::max(split, begin);
+        while (split < end && split[-1] != '\n')
+        {
+            split++;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = split;
+        begin = split;
+    }
+    if (nchunks > 1)
+    {
+        ThreadPool pool(nchunks);
+        pool.parallelFor(nchunks, [&](int i) { parseChunk(chunks[i]); });
+    } else
+    {
+        parseChunk(chunks[0]);
+    }
+
+    int line = 1;
+    size_t nverts = 0, nuvs = 0, nnormals = 0, ncorners = 0, nfaces = 0;
+    for (int i = 0; i < nchunks; i++)
+    {
+        if (chunks[i].errorLine >= 0)
+        {
+            error = "line " + std::to_string(line + chunks[i].errorLine) + ": " + chunks[i].error;
+            return false;
+        }
+        line += chunks[i].lines;
+        nverts += chunks[i].mesh.verts.size();
+        nuvs += chunks[i].mesh.uvs.size();
+        nnormals += chunks[i].mesh.normals.size();
+        ncorners += chunks[i].mesh.vertIndices.size();
+        nfaces += chunks[i].mesh.faceStart.size() - 1;
+    }
+    mesh.verts.reserve(nverts);
+    mesh.uvs.reserve(nuvs);
+    mesh.normals.reserve(nnormals);
+    mesh.vertIndices.reserve(ncorners);
+    mesh.uvIndices.reserve(ncorners);
+    mesh.normalIndices.reserve(ncorners);
+    mesh.faceStart.reserve(nfaces + 1);
+    mesh.faceStart.push_back(0);
+    for (int i = 0; i < nchunks; i++)
+    {
+        MeshData &part = chunks[i].mesh;
+        std::vector<int> *indices[3] = {&part.vertIndices, &part.uvIndices, &part.normalIndices};
+        const int offsets[3] = {(int) mesh.verts.size(), (int) mesh.uvs.size(), (int) mesh.normals.size()};
+        for (size_t j = 0; j < chunks[i].relative.size(); j++)
+        {
+            int r = chunks[i].relative[j];
+            int &index = (*indices[r % 3])[r / 3];
+            index += offsets[r % 3];
+            if (index < 0)
+            {
+                index = -2; // still out of range, but not mistaken for a missing index
+            }
+        }
+        int cornerOffset = (int) mesh.vertIndices.size();
+        mesh.verts.insert(mesh.verts.end(), part.verts.begin(), part.verts.end());
+        mesh.uvs.insert(mesh.uvs.end(), part.uvs.begin(), part.uvs.end());
+        mesh.normals.insert(mesh.normals.end(), part.normals.begin(), part.normals.end());
+        mesh.vertIndices.insert(mesh.vertIndices.end(), part.vertIndices.begin(), part.vertIndices.end());
+        mesh.uvIndices.insert(mesh.uvIndices.end(), part.uvIndices.begin(), part.uvIndices.end());
+        mesh.normalIndices.insert(mesh.normalIndices.end(), part.normalIndices.begin(), part.normalIndices.end());
+        for (size_t j = 1; j < part.faceStart.size(); j++)
+        {
+            mesh.faceStart.push_back(part.faceStart[j] + cornerOffset);
+        }
+        part = MeshData();
+    }
+
+    const std::vector<int> *indices[3] = {&mesh.vertIndices, &mesh.uvIndices, &mesh.normalIndices};
+    const int counts[3] = {(int) mesh.verts.size(), (int) mesh.uvs.size(), (int) mesh.normals.size()};
+    const char *what[3] = {"vertex", "texture coordinate", "normal"};
+    bool triangles = true;
+    for (size_t f = 0; f + 1 < mesh.faceStart.size(); f++)
+    {
+        triangles = triangles && mesh.faceStart[f + 1] - mesh.faceStart[f] == 3;
+        for (int c = mesh.faceStart[f]; c < mesh.faceStart[f + 1]; c++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                int index = (*indices[k])[c];
+                bool absent = k > 0 && index == -1;
+                if (!absent && (index < 0 || index >= counts[k]))
+                {
+                    error = "line " + std::to_string(faceLine(data, size, (int) f)) + ": " + what[k] +
+                            " index out of range";
+                    return false;
+                }
+            }
+        }
+    }
+    if (triangles)
+    {
+        mesh.faceStart.clear();
+    }
+    if (allAbsent(mesh.uvIndices))
+    {
+        mesh.uvIndices.clear();
+    }
+    if (allAbsent(mesh.normalIndices))
+    {
+        mesh.normalIndices.clear();
+    }
+    return true;
+}
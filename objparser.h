@@ -0,0 +1,13 @@
+#ifndef __OBJPARSER_H__
+#define __OBJPARSER_H__
+
+#include <cstddef>
+#include <string>
+#include "meshdata.h"
+
+// Parses an OBJ file held in memory into zero-based indices. Numbers are read without allocating and independently of
+// the C locale. Large inputs are split at line boundaries, parsed in parallel and merged in file
+// order. On malformed input returns false and sets error to "line N: what went wrong".
+bool parseObj(const char *data, size_t size, MeshData &mesh, std::string &error);
+
+#endif //__OBJPARSER_H__
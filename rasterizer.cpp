@@ -0,0 +1,794 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <string.h>
+#include "rasterizer.h"
+#include "renderstats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RASTER_X86 1
+#endif
+
+// the D3D standard patterns, which put every sample on its own row and column
+static const int pattern4[4][2] = {{-2, -6}, {6, -2}, {-6, 2}, {2, 6}};
+static const int pattern8[8][2] = {{1, -3}, {-1, 3}, {5, 1}, {-3, -5}, {-5, 5}, {-7, -1}, {3, 7}, {7, -7}};
+
+const int (*samplePattern(int samples))[2]
+{
+    switch (samples)
+    {
+        case 4:
+            return pattern4;
+        case 8:
+            return pattern8;
+        default:
+            return nullptr;
+    }
+}
+
+bool setupTriangle(const Vec3f *pts, int width, int height, TriangleSetup &setup, int samples)
+{
+    long long x[3];
+    long long y[3];
+    float z[3];
+    for (int i = 0; i < 3; i++)
+    {
+        x[i] = std::llround(pts[i].x * SUBPIXEL_ONE);
+        y[i] = std::llround(pts[i].y * SUBPIXEL_ONE);
+        z[i] = pts[i].z;
+    }
+    long long area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (area == 0)
+    {
+        return false;
+    }
+    setup.flipped = area < 0;
+    if (setup.flipped)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+
+    // pixel i is sampled at i + 0.5, i.e. at subpixel coordinate i * SUBPIXEL_ONE + half, and
+    // multisample positions lie less than half a pixel away from there
+    const long long half = SUBPIXEL_ONE / 2;
+    const long long reach = samples > 1 ? half - 1 : 0;
+    long long xmin = std::min(x[0], std::min(x[1], x[2]));
+    long long xmax = std::max(x[0], std::max(x[1], x[2]));
+    long long ymin = std::min(y[0], std::min(y[1], y[2]));
+    long long ymax = std::max(y[0], std::max(y[1], y[2]));
+    setup.minx = (int) std::max(0LL, (xmin - half - reach + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS);
+    setup.miny = (int) std::max(0LL, (ymin - half - reach + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS);
+    setup.maxx = (int) std::min((long long) width - 1, (xmax - half + reach) >> SUBPIXEL_BITS);
+    setup.maxy = (int) std::min((long long) height - 1, (ymax - half + reach) >> SUBPIXEL_BITS);
+    if (setup.minx > setup.maxx || setup.miny > setup.maxy)
+    {
+        return false;
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        int i0 = (k + 1) % 3;
+        int i1 = (k + 2) % 3;
+        long long dx = x[i1] - x[i0];
+        long long dy = y[i1] - y[i0];
+        long long a = -dy;
+        long long b = dx;
+        long long c = dy * x[i0] - dx * y[i0];
+        // top-left fill rule: pixels exactly on a right or bottom edge belong to the neighbour
+        bool topLeft = dy < 0 || (dy == 0 && dx < 0);
+        long long atCenter = a * half + b * half + c + (topLeft ? 0 : -1);
+        setup.a[k] = a;
+        setup.b[k] = b;
+        setup.c[k] = a * setup.minx + b * setup.miny + (atCenter >> SUBPIXEL_BITS);
+        setup.frac[k] = atCenter & (SUBPIXEL_ONE - 1);
+    }
+    setup.area = area;
+
+    double dx1 = (double) (x[1] - x[0]) / SUBPIXEL_ONE;
+    double dy1 = (double) (y[1] - y[0]) / SUBPIXEL_ONE;
+    double dx2 = (double) (x[2] - x[0]) / SUBPIXEL_ONE;
+    double dy2 = (double) (y[2] - y[0]) / SUBPIXEL_ONE;
+    double pixelArea = (double) area / (SUBPIXEL_ONE * SUBPIXEL_ONE);
+    double dzdx = ((z[1] - z[0]) * dy2 - (z[2] - z[0]) * dy1) / pixelArea;
+    double dzdy = ((z[2] - z[0]) * dx1 - (z[1] - z[0]) * dx2) / pixelArea;
+    double cx = setup.minx + .5 - (double) x[0] / SUBPIXEL_ONE;
+    double cy = setup.miny + .5 - (double) y[0] / SUBPIXEL_ONE;
+    setup.z0 = (float) (z[0] + dzdx * cx + dzdy * cy);
+    setup.dzdx = (float) dzdx;
+    setup.dzdy = (float) dzdy;
+    setup.zmin = std::min(z[0], std::min(z[1], z[2]));
+    setup.zmax = std::max(z[0], std::max(z[1], z[2]));
+
+    // the SIMD kernels step 32-bit lanes and may overshoot maxx by up to 7 pixels
+    const long long limit = 0x7fffffffLL;
+    long long w = setup.maxx - setup.minx + 8;
+    long long h = setup.maxy - setup.miny + 1;
+    setup.narrow = true;
+    for (int k = 0; k < 3; k++)
+    {
+        long long extent = std::llabs(setup.c[k]) + std::llabs(setup.a[k]) * w + std::llabs(setup.b[k]) * h;
+        setup.narrow = setup.narrow && extent < limit;
+    }
+    return true;
+}
+
+bool clipTriangle(const TriangleSetup &setup, int x0, int y0, int x1, int y1, TriangleSetup &clipped)
+{
+    clipped = setup;
+    clipped.minx = std::max(setup.minx, x0);
+    clipped.miny = std::max(setup.miny, y0);
+    clipped.maxx = std::min(setup.maxx, x1);
+    clipped.maxy = std::min(setup.maxy, y1);
+    if (clipped.minx > clipped.maxx || clipped.miny > clipped.maxy)
+    {
+        return false;
+    }
+    // a sub-rectangle stays within the range that made the setup narrow
+    int dx = clipped.minx - setup.minx;
+    int dy = clipped.miny - setup.miny;
+    for (int k = 0; k < 3; k++)
+    {
+        clipped.c[k] += setup.a[k] * dx + setup.b[k] * dy;
+    }
+    clipped.z0 = setup.z0 + setup.dzdy * dy + setup.dzdx * dx;
+    return true;
+}
+
+// Pixels the walks below write to, bytespp bytes each, row after row: an image, or a visibility
+// buffer.
+struct RasterTarget
+{
+    unsigned char *data;
+    int width;
+    int bytespp;
+
+    explicit RasterTarget(TGAImage &image) : data(image.buffer()), width(image.get_width()),
+                                             bytespp(image.get_bytespp())
+    {}
+
+    explicit RasterTarget(VisibilityBuffer &buffer) : data((unsigned char *) buffer.samples()),
+                                                      width(buffer.get_width()), bytespp(sizeof(VisibilitySample))
+    {}
+};
+
+// Pixel writers for the walks below, called with the edge values at the pixel center.
+struct FlatShade
+{
+    const TGAColor &color;
+    int bytespp;
+
+    inline void operator()(unsigned char *p, long long, long long, long long) const
+    { memcpy(p, color.bgra, bytespp); }
+};
+
+// Runs a shader's fragment stage, with the edge values for barycentric weights.
+template<class Shader>
+struct ShaderShade
+{
+    const Varyings &varyings;
+    const ShaderUniforms &uniforms;
+    int bytespp;
+
+    inline void operator()(unsigned char *p, long long e0, long long e1, long long e2) const
+    {
+        unsigned char color[4];
+        shadeFragment<Shader>(varyings, uniforms, (float) e0, (float) e1, (float) e2, color);
+        memcpy(p, color, bytespp);
+    }
+};
+
+// Records the triangle and its weights at the pixel center in a visibility buffer.
+struct VisibilityShade
+{
+    int id;
+
+    inline void operator()(unsigned char *p, long long e0, long long e1, long long e2) const
+    {
+        VisibilitySample *sample = (VisibilitySample *) p;
+        // the edge values add up to the area, give or take the rounding of the setup
+        float sum = (float) (e0 + e1 + e2);
+        sample->id = id;
+        sample->b1 = sum > 0 ? e1 / sum : 1.f / 3;
+        sample->b2 = sum > 0 ? e2 / sum : 1.f / 3;
+    }
+};
+
+template<class Shade>
+static void rasterizeScalarShaded(const TriangleSetup &setup, const RasterTarget &target, const Shade &shade,
+                                  PixelCounter &counter)
+{
+    int bytespp = target.bytespp;
+    unsigned long pitch = (unsigned long) target.width * bytespp;
+    unsigned char *row = target.data + setup.miny * pitch + setup.minx * bytespp;
+    size_t rowPixel = (size_t) setup.miny * target.width + setup.minx;
+    long long e0row = setup.c[0];
+    long long e1row = setup.c[1];
+    long long e2row = setup.c[2];
+    for (int y = setup.miny; y <= setup.maxy; y++)
+    {
+        long long e0 = e0row;
+        long long e1 = e1row;
+        long long e2 = e2row;
+        unsigned char *p = row;
+        counter.test(setup.maxx - setup.minx + 1);
+        for (int x = setup.minx; x <= setup.maxx; x++)
+        {
+            if ((e0 | e1 | e2) >= 0)
+            {
+                shade(p, e0, e1, e2);
+                counter.cover(1);
+                counter.write(rowPixel + x - setup.minx);
+            }
+            e0 += setup.a[0];
+            e1 += setup.a[1];
+            e2 += setup.a[2];
+            p += bytespp;
+        }
+        e0row += setup.b[0];
+        e1row += setup.b[1];
+        e2row += setup.b[2];
+        row += pitch;
+        rowPixel += target.width;
+    }
+}
+
+static void rasterizeScalar(const TriangleSetup &setup, TGAImage &image, const TGAColor &color,
+                            PixelCounter &counter)
+{
+    rasterizeScalarShaded(setup, RasterTarget(image), FlatShade{color, image.get_bytespp()}, counter);
+}
+
+#ifdef RASTER_X86
+// Fills the pixels of a coverage mask, which holds one bit per pixel starting at p.
+static inline void writeMask(unsigned char *p, unsigned int mask, const unsigned char *pattern, int bytespp)
+{
+    while (mask)
+    {
+        int first = __builtin_ctz(mask);
+        int run = __builtin_ctz(~(mask >> first));
+        memcpy(p + first * bytespp, pattern, run * bytespp);
+        mask &= ~(((1u << run) - 1) << first);
+    }
+}
+
+static void rasterizeSse2(const TriangleSetup &setup, TGAImage &image, const TGAColor &color,
+                          PixelCounter &counter)
+{
+    int bytespp = image.get_bytespp();
+    unsigned char pattern[4 * 4];
+    for (int i = 0; i < 4; i++)
+    {
+        memcpy(pattern + i * bytespp, color.bgra, bytespp);
+    }
+    unsigned long pitch = (unsigned long) image.get_width() * bytespp;
+    unsigned char *row = image.buffer() + setup.miny * pitch + setup.minx * bytespp;
+    size_t rowPixel = (size_t) setup.miny * image.get_width() + setup.minx;
+    __m128i a[3];
+    __m128i step[3];
+    int erow[3];
+    for (int k = 0; k < 3; k++)
+    {
+        int ak = (int) setup.a[k];
+        a[k] = _mm_setr_epi32(0, ak, 2 * ak, 3 * ak);
+        step[k] = _mm_set1_epi32(4 * ak);
+        erow[k] = (int) setup.c[k];
+    }
+    int span = setup.maxx - setup.minx + 1;
+    for (int y = setup.miny; y <= setup.maxy; y++)
+    {
+        __m128i e0 = _mm_add_epi32(_mm_set1_epi32(erow[0]), a[0]);
+        __m128i e1 = _mm_add_epi32(_mm_set1_epi32(erow[1]), a[1]);
+        __m128i e2 = _mm_add_epi32(_mm_set1_epi32(erow[2]), a[2]);
+        bool inside = false;
+        for (int x = 0; x < span; x += 4)
+        {
+            __m128i any = _mm_or_si128(e0, _mm_or_si128(e1, e2));
+            unsigned int mask = ~_mm_movemask_ps(_mm_castsi128_ps(any)) & 0xf;
+            if (span - x < 4)
+            {
+                mask &= (1u << (span - x)) - 1;
+            }
+            counter.test(std::min(4, span - x));
+            counter.cover(__builtin_popcount(mask));
+            counter.writeMask(rowPixel + x, mask);
+            if (mask == 0xf)
+            {
+                memcpy(row + x * bytespp, pattern, 4 * bytespp);
+            } else if (mask)
+            {
+                writeMask(row + x * bytespp, mask, pattern, bytespp);
+            } else if (inside)
+            {
+                break; // a row of a triangle is a single span
+            }
+            inside = inside || mask;
+            e0 = _mm_add_epi32(e0, step[0]);
+            e1 = _mm_add_epi32(e1, step[1]);
+            e2 = _mm_add_epi32(e2, step[2]);
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            erow[k] += (int) setup.b[k];
+        }
+        row += pitch;
+        rowPixel += image.get_width();
+    }
+}
+
+__attribute__((target("avx2")))
+static void rasterizeAvx2(const TriangleSetup &setup, TGAImage &image, const TGAColor &color,
+                          PixelCounter &counter)
+{
+    int bytespp = image.get_bytespp();
+    unsigned char pattern[8 * 4];
+    for (int i = 0; i < 8; i++)
+    {
+        memcpy(pattern + i * bytespp, color.bgra, bytespp);
+    }
+    unsigned long pitch = (unsigned long) image.get_width() * bytespp;
+    unsigned char *row = image.buffer() + setup.miny * pitch + setup.minx * bytespp;
+    size_t rowPixel = (size_t) setup.miny * image.get_width() + setup.minx;
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i a[3];
+    __m256i step[3];
+    int erow[3];
+    for (int k = 0; k < 3; k++)
+    {
+        a[k] = _mm256_mullo_epi32(lane, _mm256_set1_epi32((int) setup.a[k]));
+        step[k] = _mm256_set1_epi32(8 * (int) setup.a[k]);
+        erow[k] = (int) setup.c[k];
+    }
+    int span = setup.maxx - setup.minx + 1;
+    for (int y = setup.miny; y <= setup.maxy; y++)
+    {
+        __m256i e0 = _mm256_add_epi32(_mm256_set1_epi32(erow[0]), a[0]);
+        __m256i e1 = _mm256_add_epi32(_mm256_set1_epi32(erow[1]), a[1]);
+        __m256i e2 = _mm256_add_epi32(_mm256_set1_epi32(erow[2]), a[2]);
+        bool inside = false;
+        for (int x = 0; x < span; x += 8)
+        {
+            __m256i any = _mm256_or_si256(e0, _mm256_or_si256(e1, e2));
+            unsigned int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(any)) & 0xff;
+            if (span - x < 8)
+            {
+                mask &= (1u << (span - x)) - 1;
+            }
+            counter.test(std::min(8, span - x));
+            counter.cover(__builtin_popcount(mask));
+            counter.writeMask(rowPixel + x, mask);
+            if (mask == 0xff)
+            {
+                memcpy(row + x * bytespp, pattern, 8 * bytespp);
+            } else if (mask)
+            {
+                writeMask(row + x * bytespp, mask, pattern, bytespp);
+            } else if (inside)
+            {
+                break;
+            }
+            inside = inside || mask;
+            e0 = _mm256_add_epi32(e0, step[0]);
+            e1 = _mm256_add_epi32(e1, step[1]);
+            e2 = _mm256_add_epi32(e2, step[2]);
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            erow[k] += (int) setup.b[k];
+        }
+        row += pitch;
+        rowPixel += image.get_width();
+    }
+}
+#endif
+
+typedef void (*RasterFunc)(const TriangleSetup &, TGAImage &, const TGAColor &, PixelCounter &);
+
+struct KernelEntry
+{
+    RasterKernel kernel;
+    RasterFunc func;
+    const char *name;
+};
+
+static bool kernelSupported(RasterKernel kernel)
+{
+    switch (kernel)
+    {
+        case KERNEL_SCALAR:
+            return true;
+#ifdef RASTER_X86
+        case KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static KernelEntry kernelEntry(RasterKernel kernel)
+{
+    switch (kernel)
+    {
+#ifdef RASTER_X86
+        case KERNEL_AVX2:
+            return {KERNEL_AVX2, rasterizeAvx2, "avx2"};
+        case KERNEL_SSE2:
+            return {KERNEL_SSE2, rasterizeSse2, "sse2"};
+#endif
+        default:
+            return {KERNEL_SCALAR, rasterizeScalar, "scalar"};
+    }
+}
+
+static KernelEntry detectKernel()
+{
+#ifdef RASTER_X86
+    __builtin_cpu_init(); // may run before the libgcc constructors
+#endif
+    const RasterKernel preference[] = {KERNEL_AVX2, KERNEL_SSE2};
+    for (RasterKernel kernel : preference)
+    {
+        if (kernelSupported(kernel))
+        {
+            return kernelEntry(kernel);
+        }
+    }
+    return kernelEntry(KERNEL_SCALAR);
+}
+
+static KernelEntry activeKernel = detectKernel();
+
+bool selectRasterKernel(RasterKernel kernel)
+{
+    if (kernel == KERNEL_AUTO)
+    {
+        activeKernel = detectKernel();
+        return true;
+    }
+    if (!kernelSupported(kernel))
+    {
+        return false;
+    }
+    activeKernel = kernelEntry(kernel);
+    return true;
+}
+
+const char *rasterKernelName()
+{
+    return activeKernel.name;
+}
+
+template<class T>
+static inline T quantizeDepth(float z, float scale)
+{
+    z = z < 0.f ? 0.f : (z > 1.f ? 1.f : z);
+    return (T) (z * scale + .5f);
+}
+
+template<>
+inline float quantizeDepth<float>(float z, float)
+{
+    return z;
+}
+
+// Depth-tested rasterization, one HIZ_BLOCK square of the bounding box at a time.
+template<class T, class Shade>
+static void rasterizeDepth(const TriangleSetup &setup, const RasterTarget &target, const Shade &shade,
+                           DepthBuffer &depth, T *zbuffer, PixelCounter &counter)
+{
+    int bytespp = target.bytespp;
+    int width = target.width;
+    unsigned char *data = target.data;
+    float scale = depth.get_scale();
+    for (int by = setup.miny / HIZ_BLOCK; by <= setup.maxy / HIZ_BLOCK; by++)
+    {
+        int y0 = std::max(setup.miny, by * HIZ_BLOCK) - setup.miny;
+        int y1 = std::min(setup.maxy, by * HIZ_BLOCK + HIZ_BLOCK - 1) - setup.miny;
+        for (int bx = setup.minx / HIZ_BLOCK; bx <= setup.maxx / HIZ_BLOCK; bx++)
+        {
+            int x0 = std::max(setup.minx, bx * HIZ_BLOCK) - setup.minx;
+            int x1 = std::min(setup.maxx, bx * HIZ_BLOCK + HIZ_BLOCK - 1) - setup.minx;
+            bool outside = false;
+            for (int k = 0; k < 3; k++)
+            {
+                long long best = setup.c[k] + std::max(setup.a[k] * x0, setup.a[k] * x1) +
+                                 std::max(setup.b[k] * y0, setup.b[k] * y1);
+                outside = outside || best < 0;
+            }
+            if (outside)
+            {
+                continue;
+            }
+            float zcorner = std::max(setup.dzdy * y0, setup.dzdy * y1) + std::max(setup.dzdx * x0, setup.dzdx * x1);
+            float zblock = std::min(setup.zmax, setup.z0 + zcorner + 1e-6f);
+            if (depth.quantize(zblock) <= depth.blockMin(bx, by))
+            {
+                continue;
+            }
+            bool written = false;
+            counter.test((x1 - x0 + 1) * (y1 - y0 + 1));
+            for (int y = y0; y <= y1; y++)
+            {
+                long long e0 = setup.c[0] + setup.a[0] * x0 + setup.b[0] * y;
+                long long e1 = setup.c[1] + setup.a[1] * x0 + setup.b[1] * y;
+                long long e2 = setup.c[2] + setup.a[2] * x0 + setup.b[2] * y;
+                float zrow = setup.z0 + setup.dzdy * y;
+                unsigned long offset = (unsigned long) (setup.miny + y) * width + setup.minx + x0;
+                T *zp = zbuffer + offset;
+                unsigned char *p = data + offset * bytespp;
+                for (int x = x0; x <= x1; x++)
+                {
+                    if ((e0 | e1 | e2) >= 0)
+                    {
+                        float z = std::min(setup.zmax, std::max(setup.zmin, zrow + setup.dzdx * x));
+                        T q = quantizeDepth<T>(z, scale);
+                        counter.cover(1);
+                        if (q > *zp)
+                        {
+                            *zp = q;
+                            shade(p, e0, e1, e2);
+                            written = true;
+                            counter.write(offset + x - x0);
+                        }
+                    }
+                    e0 += setup.a[0];
+                    e1 += setup.a[1];
+                    e2 += setup.a[2];
+                    zp++;
+                    p += bytespp;
+                }
+            }
+            if (written)
+            {
+                depth.touch(bx, by);
+            }
+        }
+    }
+}
+
+// false if the triangle is hidden behind what the depth buffer holds
+template<class Shade>
+static bool rasterizeDepthTested(const TriangleSetup &setup, const RasterTarget &target, const Shade &shade,
+                                 DepthBuffer &depth, PixelCounter &counter)
+{
+    if (depth.occluded(depth.quantize(setup.zmax), setup.minx, setup.miny, setup.maxx, setup.maxy))
+    {
+        return false;
+    }
+    switch (depth.format())
+    {
+        case DEPTH_FLOAT:
+            rasterizeDepth(setup, target, shade, depth, depth.floats(), counter);
+            break;
+        case DEPTH_24:
+            rasterizeDepth(setup, target, shade, depth, depth.ints(), counter);
+            break;
+        default:
+            rasterizeDepth(setup, target, shade, depth, depth.shorts(), counter);
+            break;
+    }
+    return true;
+}
+
+void rasterizeTriangle(const TriangleSetup &setup, TGAImage &image, const TGAColor &color, DepthBuffer *depth)
+{
+    PixelCounter counter(image.get_width(), image.get_height());
+    if (depth && depth->format() != DEPTH_NONE)
+    {
+        rasterizeDepthTested(setup, RasterTarget(image), FlatShade{color, image.get_bytespp()}, *depth, counter);
+    } else if (setup.narrow)
+    {
+        activeKernel.func(setup, image, color, counter);
+    } else
+    {
+        rasterizeScalar(setup, image, color, counter);
+    }
+}
+
+template<class Shader>
+void rasterizeShaded(const TriangleSetup &setup, const Varyings &varyings, const ShaderUniforms &uniforms,
+                     TGAImage &image, DepthBuffer *depth)
+{
+    PixelCounter counter(image.get_width(), image.get_height());
+    ShaderShade<Shader> shade{varyings, uniforms, image.get_bytespp()};
+    if (depth && depth->format() != DEPTH_NONE)
+    {
+        rasterizeDepthTested(setup, RasterTarget(image), shade, *depth, counter);
+    } else
+    {
+        rasterizeScalarShaded(setup, RasterTarget(image), shade, counter);
+    }
+}
+
+template<>
+void rasterizeShaded<FlatShader<false> >(const TriangleSetup &setup, const Varyings &varyings,
+                                         const ShaderUniforms &, TGAImage &image, DepthBuffer *depth)
+{
+    rasterizeTriangle(setup, image, varyings.color, depth);
+}
+
+template void rasterizeShaded<FlatShader<true> >(const TriangleSetup &, const Varyings &, const ShaderUniforms &,
+                                                 TGAImage &, DepthBuffer *);
+
+template void rasterizeShaded<GouraudShader<false> >(const TriangleSetup &, const Varyings &,
+                                                     const ShaderUniforms &, TGAImage &, DepthBuffer *);
+
+template void rasterizeShaded<GouraudShader<true> >(const TriangleSetup &, const Varyings &,
+                                                    const ShaderUniforms &, TGAImage &, DepthBuffer *);
+
+template void rasterizeShaded<PhongShader<false> >(const TriangleSetup &, const Varyings &, const ShaderUniforms &,
+                                                   TGAImage &, DepthBuffer *);
+
+template void rasterizeShaded<PhongShader<true> >(const TriangleSetup &, const Varyings &, const ShaderUniforms &,
+                                                  TGAImage &, DepthBuffer *);
+
+void rasterizeVisibility(const TriangleSetup &setup, int id, VisibilityBuffer &target, DepthBuffer *depth)
+{
+    PixelCounter counter(target.get_width(), target.get_height());
+    if (depth && depth->format() != DEPTH_NONE)
+    {
+        rasterizeDepthTested(setup, RasterTarget(target), VisibilityShade{id}, *depth, counter);
+    } else
+    {
+        rasterizeScalarShaded(setup, RasterTarget(target), VisibilityShade{id}, counter);
+    }
+}
+
+template<class Shader>
+void resolveShaded(const VisibilitySample *samples, int count, const Varyings &varyings,
+                   const ShaderUniforms &uniforms, unsigned char *out, int bytespp)
+{
+    for (int i = 0; i < count; i++)
+    {
+        unsigned char color[4];
+        shadeFragment<Shader>(varyings, uniforms, 1.f - samples[i].b1 - samples[i].b2, samples[i].b1, samples[i].b2,
+                              color);
+        memcpy(out + i * bytespp, color, bytespp);
+    }
+}
+
+template void resolveShaded<FlatShader<false> >(const VisibilitySample *, int, const Varyings &,
+                                                const ShaderUniforms &, unsigned char *, int);
+
+template void resolveShaded<FlatShader<true> >(const VisibilitySample *, int, const Varyings &,
+                                               const ShaderUniforms &, unsigned char *, int);
+
+template void resolveShaded<GouraudShader<false> >(const VisibilitySample *, int, const Varyings &,
+                                                   const ShaderUniforms &, unsigned char *, int);
+
+template void resolveShaded<GouraudShader<true> >(const VisibilitySample *, int, const Varyings &,
+                                                  const ShaderUniforms &, unsigned char *, int);
+
+template void resolveShaded<PhongShader<false> >(const VisibilitySample *, int, const Varyings &,
+                                                 const ShaderUniforms &, unsigned char *, int);
+
+template void resolveShaded<PhongShader<true> >(const VisibilitySample *, int, const Varyings &,
+                                                const ShaderUniforms &, unsigned char *, int);
+
+void rasterizeTriangle(const TriangleSetup &setup, SampleBuffer &target, const TGAColor &color, bool depthTest)
+{
+    int samples = target.get_samples();
+    const int (*pattern)[2] = samplePattern(samples);
+    int width = target.get_width();
+    int bytespp = target.get_bytespp();
+    // the edge value at a sample is the one at the pixel center plus a constant per sample
+    long long offset[3][MAX_SAMPLES];
+    long long reach[3];
+    float dz[MAX_SAMPLES];
+    for (int k = 0; k < 3; k++)
+    {
+        reach[k] = LLONG_MIN;
+        for (int s = 0; s < samples; s++)
+        {
+            offset[k][s] = (setup.frac[k] + setup.a[k] * pattern[s][0] + setup.b[k] * pattern[s][1]) >> SUBPIXEL_BITS;
+            reach[k] = std::max(reach[k], offset[k][s]);
+        }
+    }
+    for (int s = 0; s < samples; s++)
+    {
+        dz[s] = (setup.dzdx * pattern[s][0] + setup.dzdy * pattern[s][1]) / SUBPIXEL_ONE;
+    }
+    unsigned char *colors = target.colors();
+    float *depths = target.depths();
+    PixelCounter counter(width, target.get_height());
+    for (int y = 0; y <= setup.maxy - setup.miny; y++)
+    {
+        counter.test(setup.maxx - setup.minx + 1);
+        long long e0 = setup.c[0] + setup.b[0] * y;
+        long long e1 = setup.c[1] + setup.b[1] * y;
+        long long e2 = setup.c[2] + setup.b[2] * y;
+        float zrow = setup.z0 + setup.dzdy * y;
+        size_t first = ((size_t) (setup.miny + y) * width + setup.minx) * samples;
+        for (int x = 0; x <= setup.maxx - setup.minx; x++, e0 += setup.a[0], e1 += setup.a[1], e2 += setup.a[2])
+        {
+            // no sample can be inside if the best placed one for some edge is not
+            if (((e0 + reach[0]) | (e1 + reach[1]) | (e2 + reach[2])) < 0)
+            {
+                continue;
+            }
+            float zpixel = zrow + setup.dzdx * x;
+            size_t pixel = first + (size_t) x * samples;
+            bool covered = false;
+            bool written = false;
+            for (int s = 0; s < samples; s++)
+            {
+                if (((e0 + offset[0][s]) | (e1 + offset[1][s]) | (e2 + offset[2][s])) < 0)
+                {
+                    continue;
+                }
+                covered = true;
+                float z = std::min(setup.zmax, std::max(setup.zmin, zpixel + dz[s]));
+                if (!depthTest || z > depths[pixel + s])
+                {
+                    depths[pixel + s] = z;
+                    memcpy(colors + (pixel + s) * bytespp, color.bgra, bytespp);
+                    written = true;
+                }
+            }
+            // a pixel counts once however many of its samples are covered or written
+            counter.cover(covered);
+            if (written)
+            {
+                counter.write(pixel / samples);
+            }
+        }
+    }
+}
+
+void triangleEdge(const Vec3f *pts, TGAImage &image, const TGAColor &color, DepthBuffer *depth)
+{
+    TriangleSetup setup;
+    if (setupTriangle(pts, image.get_width(), image.get_height(), setup))
+    {
+        rasterizeTriangle(setup, image, color, depth);
+    }
+}
+
+Vec3f barycentric(Vec2i *pts, Vec2i p)
+{
+    Vec3f u = cross(Vec3f(pts[2][0] - pts[0][0], pts[1][0] - pts[0][0], pts[0][0] - p[0]),
+                    Vec3f(pts[2][1] - pts[0][1], pts[1][1] - pts[0][1], pts[0][1] - p[1]));
+    if (std::abs(u[2]) < 1)
+    {
+        return Vec3f(-1, 1, 1);
+    }
+    return Vec3f(1.f - (u.x + u.y) / u.z, u.y / u.z, u.x / u.z);
+}
+
+void triangle(Vec2i *pts, TGAImage &image, TGAColor color)
+{
+    Vec2i bboxmin(image.get_width() - 1, image.get_height() - 1);
+    Vec2i bboxmax(0, 0);
+    Vec2i clamp(image.get_width() - 1, image.get_height() - 1);
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 2; j++)
+        {
+            bboxmin[j] = std::max(0, std::min(bboxmin[j], pts[i][j]));
+            bboxmax[j] = std::min(clamp[j], std::max(bboxmax[j], pts[i][j]));
+        }
+    }
+    PixelCounter counter(image.get_width(), image.get_height());
+    counter.test(std::max(0, bboxmax.x - bboxmin.x + 1) * std::max(0, bboxmax.y - bboxmin.y + 1));
+    Vec2i p;
+    for (p.x = bboxmin.x; p.x <= bboxmax.x; p.x++)
+    {
+        for (p.y = bboxmin.y; p.y <= bboxmax.y; p.y++)
+        {
+            Vec3f bcScreen = barycentric(pts, p);
+            if (bcScreen.x < 0 || bcScreen.y < 0 || bcScreen.z < 0)
+            {
+                continue;
+            }
+            image.set(p.x, p.y, color);
+            counter.cover(1);
+            counter.write((size_t) p.y * image.get_width() + p.x);
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef __RASTERIZER_H__
+#define __RASTERIZER_H__
+
+#include "depthbuffer.h"
+#include "geometry.h"
+#include "samplebuffer.h"
+#include "shader.h"
+#include "tgaimage.h"
+#include "visibilitybuffer.h"
+
+// Vertices are snapped to a 1/16 pixel grid before the edge functions are built.
+const int SUBPIXEL_BITS = 4;
+const int SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+
+// Integer edge equations of a counter-clockwise triangle, evaluated at pixel centers.
+// Edge k is the one opposite to vertex k, so e[k] >= 0 on every covered pixel and
+// e[k] / area is the barycentric weight of vertex k. The values are reduced to whole
+// pixel steps: moving one pixel right adds a[k], moving one pixel up adds b[k].
+// Depth is a plane over the pixel centers, clamped to the range spanned by the vertices.
+struct TriangleSetup
+{
+    long long a[3];
+    long long b[3];
+    long long c[3]; // edge values at (minx, miny)
+    long long frac[3]; // subpixel remainders dropped from c, needed to test points off the center
+    long long area; // twice the triangle area, in subpixel units
+    int minx, miny, maxx, maxy;
+    float z0; // depth at (minx, miny)
+    float dzdx;
+    float dzdy;
+    float zmin;
+    float zmax;
+    bool narrow; // every edge value over the bounding box fits in 32 bits
+    bool flipped; // vertices 1 and 2 were swapped to make the triangle counter-clockwise
+};
+
+enum RasterKernel
+{
+    KERNEL_AUTO, KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2
+};
+
+// Chooses the coverage kernel used by rasterizeTriangle(). KERNEL_AUTO picks the widest
+// one the CPU supports, which is also what happens at startup. Returns false if the
+// requested kernel is not available on this machine.
+bool selectRasterKernel(RasterKernel kernel);
+
+const char *rasterKernelName();
+
+// Standard multisample patterns: samples 4 or 8 offsets from the pixel center, x then y, in
+// 1/SUBPIXEL_ONE pixel units. Null for any other count.
+const int (*samplePattern(int samples))[2];
+
+// pts hold screen x, y and depth z. With more than one sample the bounding box also takes in
+// pixels whose center is outside the triangle but some sample of the pattern may be inside.
+bool setupTriangle(const Vec3f *pts, int width, int height, TriangleSetup &setup, int samples = 1);
+
+// Restricts a setup to the pixel rectangle [x0, x1] x [y0, y1], inclusive. Returns false
+// if the bounding box of the triangle misses the rectangle.
+bool clipTriangle(const TriangleSetup &setup, int x0, int y0, int x1, int y1, TriangleSetup &clipped);
+
+// With a depth buffer the triangle is walked in HIZ_BLOCK squares, skipping squares that lie
+// outside an edge or behind what has been drawn, and only pixels passing the depth test are
+// written. Without one the SIMD coverage kernel fills every covered pixel.
+void rasterizeTriangle(const TriangleSetup &setup, TGAImage &image, const TGAColor &color,
+                       DepthBuffer *depth = nullptr);
+
+// Multisampled rasterization: coverage and depth are evaluated at every sample of the buffer's
+// pattern, the colour once per pixel, and every covered sample that is closer than the one
+// stored (or any covered sample without depthTest) takes both. setup must come from
+// setupTriangle() with the buffer's sample count.
+void rasterizeTriangle(const TriangleSetup &setup, SampleBuffer &target, const TGAColor &color, bool depthTest);
+
+// Runs the vertex stage of a shader on the corners of a triangle, given in the order passed to
+// setupTriangle() with the reciprocals of their clip-space w, and keeps the outputs in the order
+// of the setup. Textured shaders get the mip level picked once per triangle, from the ratio of
+// its texel area to its pixel area. varyings.color is left to the caller.
+template<class Shader>
+inline void setupVaryings(const TriangleSetup &setup, const ShaderVertex *corners, const float *invw,
+                          const ShaderUniforms &uniforms, Varyings &varyings)
+{
+    for (int k = 0; k < 3; k++)
+    {
+        // follow the vertex order of the setup
+        int i = setup.flipped && k ? 3 - k : k;
+        float out[MAX_VARYINGS];
+        Shader::vertex(uniforms, corners[i], out);
+        for (int j = 0; j < Shader::VARYINGS; j++)
+        {
+            varyings.value[k][j] = out[j] * invw[i];
+        }
+        varyings.q[k] = invw[i];
+    }
+    varyings.level = 0;
+    if (Shader::TEXTURED)
+    {
+        const Texture &texture = *uniforms.texture;
+        Vec2f d1 = corners[1].uv - corners[0].uv;
+        Vec2f d2 = corners[2].uv - corners[0].uv;
+        float texelArea = std::fabs(d1.x * d2.y - d1.y * d2.x) / 2 * texture.width(0) * texture.height(0);
+        float pixelArea = (float) setup.area / (2 * SUBPIXEL_ONE * SUBPIXEL_ONE);
+        varyings.level = texture.selectLevel(texelArea, pixelArea);
+    }
+}
+
+// Draws a triangle with a shader, depth tested like the flat rasterizeTriangle(): the fragment
+// stage runs once for every pixel written, on varyings interpolated perspective-correct. Flat
+// untextured shading is that rasterizeTriangle(), SIMD coverage kernels included.
+template<class Shader>
+void rasterizeShaded(const TriangleSetup &setup, const Varyings &varyings, const ShaderUniforms &uniforms,
+                     TGAImage &image, DepthBuffer *depth);
+
+template<>
+void rasterizeShaded<FlatShader<false> >(const TriangleSetup &setup, const Varyings &varyings,
+                                         const ShaderUniforms &uniforms, TGAImage &image, DepthBuffer *depth);
+
+// rasterizeShaded() of the shader a triangle was set up for
+typedef void (*ShadedRasterFunc)(const TriangleSetup &, const Varyings &, const ShaderUniforms &, TGAImage &,
+                                 DepthBuffer *);
+
+// Writes the triangle's id and weights to the covered pixels of a visibility buffer, depth tested
+// like rasterizeTriangle() when a depth buffer is given.
+void rasterizeVisibility(const TriangleSetup &setup, int id, VisibilityBuffer &target, DepthBuffer *depth = nullptr);
+
+// Shades count consecutive pixels of a visibility buffer, all showing the triangle the varyings
+// belong to, into out.
+template<class Shader>
+void resolveShaded(const VisibilitySample *samples, int count, const Varyings &varyings,
+                   const ShaderUniforms &uniforms, unsigned char *out, int bytespp);
+
+typedef void (*ShadedResolveFunc)(const VisibilitySample *, int, const Varyings &, const ShaderUniforms &,
+                                  unsigned char *, int);
+
+void triangleEdge(const Vec3f *pts, TGAImage &image, const TGAColor &color, DepthBuffer *depth = nullptr);
+
+// Reference rasterizer: tests every pixel of the bounding box with floating point barycentric
+// coordinates. No fill rule and no depth test.
+Vec3f barycentric(Vec2i *pts, Vec2i p);
+
+void triangle(Vec2i *pts, TGAImage &image, TGAColor color);
+
+#endif //__RASTERIZER_H__
@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <cmath>
+#include "renderer.h"
+#include "renderstats.h"
+
+static_assert(TILE_SIZE % HIZ_TILE == 0, "render tiles must not split hierarchical depth tiles");
+
+TileRenderer::TileRenderer(ThreadPool &pool) : pool_(pool), bins_(), tilesX_(0), tilesY_(0)
+{}
+
+void TileRenderer::bin(const std::vector<ScreenTriangle> &triangles, int chunk, int nchunks)
+{
+    int ntiles = tilesX_ * tilesY_;
+    std::vector<int> *bins = &bins_[chunk * ntiles];
+    for (int t = 0; t < ntiles; t++)
+    {
+        bins[t].clear();
+    }
+    int begin = (int) ((long long) chunk * triangles.size() / nchunks);
+    int end = (int) ((long long) (chunk + 1) * triangles.size() / nchunks);
+    for (int i = begin; i < end; i++)
+    {
+        const TriangleSetup &setup = triangles[i].setup;
+        for (int ty = setup.miny / TILE_SIZE; ty <= setup.maxy / TILE_SIZE; ty++)
+        {
+            for (int tx = setup.minx / TILE_SIZE; tx <= setup.maxx / TILE_SIZE; tx++)
+            {
+                bins[ty * tilesX_ + tx].push_back(i);
+            }
+        }
+    }
+}
+
+void TileRenderer::drawTile(const std::vector<ScreenTriangle> &triangles, const Target &target, int tile,
+                            int nchunks)
+{
+    int ntiles = tilesX_ * tilesY_;
+    int x0 = (tile % tilesX_) * TILE_SIZE;
+    int y0 = (tile / tilesX_) * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, target.width) - 1;
+    int y1 = std::min(y0 + TILE_SIZE, target.height) - 1;
+    if (target.samples)
+    {
+        target.samples->clear(x0, y0, x1, y1);
+    }
+    // chunks hold consecutive triangle ranges, so walking them in order keeps submission order
+    for (int chunk = 0; chunk < nchunks; chunk++)
+    {
+        const std::vector<int> &bin = bins_[chunk * ntiles + tile];
+        for (size_t i = 0; i < bin.size(); i++)
+        {
+            const ScreenTriangle &triangle = triangles[bin[i]];
+            TriangleSetup clipped;
+            if (!clipTriangle(triangle.setup, x0, y0, x1, y1, clipped))
+            {
+                continue;
+            }
+            if (target.visibility)
+            {
+                rasterizeVisibility(clipped, bin[i], *target.visibility, target.depth);
+            } else if (target.samples)
+            {
+                rasterizeTriangle(clipped, *target.samples, triangle.varyings.color, target.depthTest);
+            } else
+            {
+                triangle.raster(clipped, triangle.varyings, *target.uniforms, *target.image, target.depth);
+            }
+        }
+    }
+    if (target.samples)
+    {
+        target.samples->resolve(*target.image, x0, y0, x1, y1);
+    }
+}
+
+void TileRenderer::draw(const std::vector<ScreenTriangle> &triangles, const ShaderUniforms &uniforms,
+                        TGAImage &image, DepthBuffer *depth)
+{
+    Target target = {image.get_width(), image.get_height(), &image, depth, nullptr, nullptr, &uniforms, false};
+    draw(triangles, target);
+}
+
+void TileRenderer::draw(const std::vector<ScreenTriangle> &triangles, TGAImage &image, SampleBuffer &samples,
+                        bool depthTest)
+{
+    Target target = {image.get_width(), image.get_height(), &image, nullptr, &samples, nullptr, nullptr, depthTest};
+    draw(triangles, target);
+}
+
+void TileRenderer::draw(const std::vector<ScreenTriangle> &triangles, VisibilityBuffer &visibility,
+                        DepthBuffer *depth)
+{
+    Target target = {visibility.get_width(), visibility.get_height(), nullptr, depth, nullptr, &visibility, nullptr,
+                     false};
+    draw(triangles, target);
+}
+
+void TileRenderer::draw(const std::vector<ScreenTriangle> &triangles, const Target &target)
+{
+    tilesX_ = (target.width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY_ = (target.height + TILE_SIZE - 1) / TILE_SIZE;
+    int ntiles = tilesX_ * tilesY_;
+    int nchunks = pool_.size();
+    if ((int) bins_.size() < nchunks * ntiles)
+    {
+        bins_.resize(nchunks * ntiles);
+    }
+    pool_.parallelFor(nchunks, [&](int chunk) { bin(triangles, chunk, nchunks); });
+    pool_.parallelFor(ntiles, [&](int tile) { drawTile(triangles, target, tile, nchunks); });
+}
+
+bool Camera::degenerate() const
+{
+    Vec3f view = center - eye;
+    return view.norm() == 0 || cross(view, up).norm() == 0;
+}
+
+Mat4f Camera::matrix(int width, int height) const
+{
+    float aspect = (float) width / height;
+    float distance = (eye - center).norm();
+    float n = zNear;
+    float f = zFar;
+    if (f <= n)
+    {
+        // the corners of the unit cube are sqrt(3) away from its center
+        n = distance - 1.7320508f;
+        f = distance + 1.7320508f;
+    }
+    Mat4f projection;
+    if (fov > 0)
+    {
+        projection = perspective(fov * (float) M_PI / 180.f, aspect, std::max(n, distance * .01f), f);
+    } else
+    {
+        projection = orthographic(scale, aspect, n, f);
+    }
+    return viewport(0, 0, width, height) * projection * lookAt(eye, center, up);
+}
+
+Vec3f RenderSettings::lightDirection() const
+{
+    Vec3f direction = light.norm() > 0 ? light : camera.eye - camera.center;
+    return direction.normalize();
+}
+
+FrameRenderer::FrameRenderer(ThreadPool *pool) : pool_(pool), tiles_(), depth_(), samples_(), visibility_(),
+                                                  vertices_(), corners_(), uvCorners_(), normalCorners_(),
+                                                  intensities_(), lighting_(), triangles_(), visibleTriangles_(),
+                                                  inputs_(), resolvers_(), visibilityTexture_(nullptr), wireframe_(pool)
+{
+    if (pool_ && pool_->size() > 1)
+    {
+        tiles_.reset(new TileRenderer(*pool_));
+    }
+}
+
+template<template<bool> class Shader>
+int FrameRenderer::setupTriangles(const Model &model, const RenderSettings &settings, const ShaderUniforms &uniforms,
+                                  const float *lighting, bool keepInputs, int width, int height, TGAImage *image)
+{
+    int ntriangles = (int) corners_.size() / 3;
+    triangles_.clear();
+    if (keepInputs)
+    {
+        inputs_.clear();
+    }
+    int drawn = 0;
+    int culled = 0;
+    int clippedFaces = 0;
+    for (int i = 0; i < ntriangles; i++)
+    {
+        if (!(intensities_[i] > 0))
+        {
+            culled++;
+            continue;
+        }
+        const int *corners = &corners_[3 * i];
+        Vec3f screenCoords[3];
+        bool clipped = false;
+        for (int j = 0; j < 3; j++)
+        {
+            screenCoords[j] = vertices_.get(corners[j]);
+            // no clipping yet: triangles crossing the near or far plane are dropped whole
+            clipped = clipped || !(screenCoords[j].z >= 0 && screenCoords[j].z <= 1);
+        }
+        if (clipped)
+        {
+            clippedFaces++;
+            continue;
+        }
+        unsigned char level = lightLevel(lighting[i]);
+        TGAColor color(level, level, level, 255);
+        if (settings.raster == RASTER_EDGE)
+        {
+            ScreenTriangle triangle;
+            if (!setupTriangle(screenCoords, width, height, triangle.setup, settings.samples))
+            {
+                continue;
+            }
+            triangle.varyings.color = color;
+            const int *uvs = uniforms.texture ? &uvCorners_[3 * i] : nullptr;
+            bool textured = uvs && uvs[0] >= 0 && uvs[1] >= 0 && uvs[2] >= 0;
+            if (Shader<false>::VARYINGS == 0 && !textured && !keepInputs)
+            {
+                // a flat grey face has no varyings, its colour is all it takes
+                triangle.raster = rasterizeShaded<Shader<false> >;
+                triangles_.push_back(triangle);
+                continue;
+            }
+            const int *normals = normalCorners_.empty() ? nullptr : &normalCorners_[3 * i];
+            bool smooth = normals && normals[0] >= 0 && normals[1] >= 0 && normals[2] >= 0;
+            Vec3f faceNormal;
+            if (!smooth || keepInputs)
+            {
+                const Vec3f *verts = model.mesh().verts.data();
+                faceNormal = cross(verts[corners[1]] - verts[corners[0]], verts[corners[2]] - verts[corners[0]]);
+                faceNormal.normalize();
+            }
+            ShadingInputs inputs;
+            for (int j = 0; j < 3; j++)
+            {
+                ShaderVertex &vertex = inputs.vertices[j];
+                if (smooth)
+                {
+                    vertex.normal = model.normal(normals[j]);
+                    vertex.normal.normalize();
+                } else
+                {
+                    vertex.normal = faceNormal;
+                }
+                vertex.uv = textured ? model.uv(uvs[j]) : Vec2f();
+                inputs.invw[j] = vertices_.invw[corners[j]];
+            }
+            if (textured)
+            {
+                triangle.raster = rasterizeShaded<Shader<true> >;
+                setupVaryings<Shader<true> >(triangle.setup, inputs.vertices, inputs.invw, uniforms,
+                                             triangle.varyings);
+            } else
+            {
+                triangle.raster = rasterizeShaded<Shader<false> >;
+                setupVaryings<Shader<false> >(triangle.setup, inputs.vertices, inputs.invw, uniforms,
+                                              triangle.varyings);
+            }
+            triangles_.push_back(triangle);
+            if (keepInputs)
+            {
+                inputs.normal = faceNormal;
+                inputs.textured = textured;
+                inputs_.push_back(inputs);
+            }
+        } else
+        {
+            Vec2i pts[3];
+            for (int j = 0; j < 3; j++)
+            {
+                pts[j] = Vec2i(screenCoords[j].x, screenCoords[j].y);
+            }
+            triangle(pts, *image, color);
+            drawn++;
+        }
+    }
+    if (settings.raster == RASTER_EDGE)
+    {
+        drawn = (int) triangles_.size();
+    }
+    countStat(FACES_SUBMITTED, ntriangles);
+    countStat(FACES_CULLED, culled);
+    countStat(FACES_CLIPPED, clippedFaces);
+    countStat(FACES_RASTERIZED, drawn);
+    return drawn;
+}
+
+int FrameRenderer::setupFaces(const Model &model, const RenderSettings &settings, ShadingMode shading,
+                              const ShaderUniforms &uniforms, bool keepInputs, int width, int height,
+                              TGAImage *image)
+{
+    bool normals = (shading != SHADING_FLAT || keepInputs) && model.nnormals() > 0;
+    // faces with more than three corners are drawn as a fan around the first one
+    corners_.clear();
+    uvCorners_.clear();
+    normalCorners_.clear();
+    for (int i = 0; i < model.nfaces(); i++)
+    {
+        Span<int> face = model.face(i);
+        Span<int> uvs = uniforms.texture ? model.faceUvs(i) : Span<int>();
+        Span<int> faceNormals = normals ? model.faceNormals(i) : Span<int>();
+        for (int t = 1; t + 1 < face.size; t++)
+        {
+            const int fan[3] = {0, t, t + 1};
+            for (int j = 0; j < 3; j++)
+            {
+                corners_.push_back(face[fan[j]]);
+                if (uniforms.texture)
+                {
+                    uvCorners_.push_back(uvs.size ? uvs[fan[j]] : -1);
+                }
+                if (normals)
+                {
+                    normalCorners_.push_back(faceNormals.size ? faceNormals[fan[j]] : -1);
+                }
+            }
+        }
+    }
+    // faceLighting() takes the direction the light travels in, the eye looks along it
+    const Camera &camera = settings.camera;
+    Vec3f view = camera.center - camera.eye;
+    view.normalize();
+    int ntriangles = (int) corners_.size() / 3;
+    intensities_.resize(ntriangles);
+    faceLighting(model.mesh().verts.data(), corners_.data(), ntriangles, view, intensities_.data());
+    const float *lighting = intensities_.data();
+    if (settings.light.norm() > 0)
+    {
+        lighting_.resize(ntriangles);
+        faceLighting(model.mesh().verts.data(), corners_.data(), ntriangles, uniforms.light * -1.f, lighting_.data());
+        lighting = lighting_.data();
+    }
+    switch (shading)
+    {
+        case SHADING_GOURAUD:
+            return setupTriangles<GouraudShader>(model, settings, uniforms, lighting, keepInputs, width, height, image);
+        case SHADING_PHONG:
+            return setupTriangles<PhongShader>(model, settings, uniforms, lighting, keepInputs, width, height, image);
+        default:
+            return setupTriangles<FlatShader>(model, settings, uniforms, lighting, keepInputs, width, height, image);
+    }
+}
+
+int FrameRenderer::render(const Model &model, const RenderSettings &settings, TGAImage &image)
+{
+    int width = image.get_width();
+    int height = image.get_height();
+    StageTimer transformTimer(STAGE_TRANSFORM);
+    transformVertices(model.mesh().verts.data(), model.nverts(), settings.camera.matrix(width, height), vertices_,
+                      pool_);
+    transformTimer.stop();
+    if (settings.raster == RASTER_WIREFRAME)
+    {
+        StageTimer rasterTimer(STAGE_RASTER);
+        return wireframe_.draw(model, vertices_, image, TGAColor(255, 255, 255, 255));
+    }
+    // the barycentric rasterizer draws while the faces are set up, which then counts as raster time
+    StageTimer setupTimer(settings.raster == RASTER_EDGE ? STAGE_SETUP : STAGE_RASTER);
+    bool shaded = settings.raster == RASTER_EDGE && settings.samples == 1;
+    ShaderUniforms uniforms;
+    uniforms.light = settings.lightDirection();
+    uniforms.texture = shaded && model.nuvs() > 0 ? settings.texture : nullptr;
+    int drawn = setupFaces(model, settings, shaded ? settings.shading : SHADING_FLAT, uniforms, false, width, height,
+                           &image);
+    setupTimer.stop();
+    if (settings.raster != RASTER_EDGE)
+    {
+        return drawn;
+    }
+    StageTimer rasterTimer(STAGE_RASTER);
+    if (settings.samples > 1)
+    {
+        drawMultisampled(settings, image);
+        return drawn;
+    }
+    if (!depth_ || depth_->get_width() != width || depth_->get_height() != height ||
+        depth_->format() != settings.depth)
+    {
+        depth_.reset(new DepthBuffer(width, height, settings.depth));
+    } else
+    {
+        depth_->clear();
+    }
+    if (tiles_)
+    {
+        tiles_->draw(triangles_, uniforms, image, depth_.get());
+    } else
+    {
+        for (size_t i = 0; i < triangles_.size(); i++)
+        {
+            const ScreenTriangle &triangle = triangles_[i];
+            triangle.raster(triangle.setup, triangle.varyings, uniforms, image, depth_.get());
+        }
+    }
+    return drawn;
+}
+
+int FrameRenderer::renderVisibility(const Model &model, const RenderSettings &settings, int width, int height)
+{
+    StageTimer transformTimer(STAGE_TRANSFORM);
+    transformVertices(model.mesh().verts.data(), model.nverts(), settings.camera.matrix(width, height), vertices_,
+                      pool_);
+    transformTimer.stop();
+    StageTimer setupTimer(STAGE_SETUP);
+    RenderSettings edge = settings;
+    edge.raster = RASTER_EDGE;
+    edge.samples = 1;
+    ShaderUniforms uniforms;
+    uniforms.light = settings.lightDirection();
+    uniforms.texture = model.nuvs() > 0 ? settings.texture : nullptr;
+    visibilityTexture_ = uniforms.texture;
+    int drawn = setupFaces(model, edge, SHADING_FLAT, uniforms, true, width, height, nullptr);
+    setupTimer.stop();
+    StageTimer rasterTimer(STAGE_RASTER);
+    if (!depth_ || depth_->get_width() != width || depth_->get_height() != height ||
+        depth_->format() != settings.depth)
+    {
+        depth_.reset(new DepthBuffer(width, height, settings.depth));
+    } else
+    {
+        depth_->clear();
+    }
+    if (!visibility_ || visibility_->get_width() != width || visibility_->get_height() != height)
+    {
+        visibility_.reset(new VisibilityBuffer(width, height));
+    } else
+    {
+        visibility_->clear();
+    }
+    if (tiles_)
+    {
+        tiles_->draw(triangles_, *visibility_, depth_.get());
+    } else
+    {
+        for (size_t i = 0; i < triangles_.size(); i++)
+        {
+            rasterizeVisibility(triangles_[i].setup, (int) i, *visibility_, depth_.get());
+        }
+    }
+    visibleTriangles_.swap(triangles_);
+    return drawn;
+}
+
+template<template<bool> class Shader>
+void FrameRenderer::relightTriangles(const ShaderUniforms &uniforms, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        const ShadingInputs &inputs = inputs_[i];
+        ScreenTriangle &triangle = visibleTriangles_[i];
+        unsigned char level = lightLevel(inputs.normal * uniforms.light);
+        triangle.varyings.color = TGAColor(level, level, level, 255);
+        if (inputs.textured)
+        {
+            setupVaryings<Shader<true> >(triangle.setup, inputs.vertices, inputs.invw, uniforms, triangle.varyings);
+            resolvers_[i] = resolveShaded<Shader<true> >;
+        } else
+        {
+            setupVaryings<Shader<false> >(triangle.setup, inputs.vertices, inputs.invw, uniforms, triangle.varyings);
+            resolvers_[i] = resolveShaded<Shader<false> >;
+        }
+    }
+}
+
+void FrameRenderer::resolveRows(const ShaderUniforms &uniforms, TGAImage &image, int y0, int y1) const
+{
+    int width = image.get_width();
+    int bytespp = image.get_bytespp();
+    for (int y = y0; y < y1; y++)
+    {
+        const VisibilitySample *row = visibility_->samples() + (size_t) y * width;
+        unsigned char *out = image.buffer() + (size_t) y * width * bytespp;
+        // a triangle covers runs of pixels, each of which takes one call into its shader
+        for (int x = 0; x < width;)
+        {
+            int id = row[x].id;
+            int end = x + 1;
+            while (end < width && row[end].id == id)
+            {
+                end++;
+            }
+            if (id >= 0)
+            {
+                resolvers_[id](row + x, end - x, visibleTriangles_[id].varyings, uniforms, out + x * bytespp, bytespp);
+            }
+            x = end;
+        }
+    }
+}
+
+bool FrameRenderer::resolve(const RenderSettings &settings, TGAImage &image)
+{
+    if (!visibility_ || visibility_->get_width() != image.get_width() ||
+        visibility_->get_height() != image.get_height())
+    {
+        return false;
+    }
+    StageTimer resolveTimer(STAGE_RESOLVE);
+    ShaderUniforms uniforms;
+    uniforms.light = settings.lightDirection();
+    uniforms.texture = visibilityTexture_;
+    int ntriangles = (int) visibleTriangles_.size();
+    resolvers_.resize(ntriangles);
+    int nchunks = pool_ ? pool_->size() : 1;
+    auto relight = [&](int chunk) {
+        int begin = (int) ((long long) chunk * ntriangles / nchunks);
+        int end = (int) ((long long) (chunk + 1) * ntriangles / nchunks);
+        switch (settings.shading)
+        {
+            case SHADING_GOURAUD:
+                relightTriangles<GouraudShader>(uniforms, begin, end);
+                break;
+            case SHADING_PHONG:
+                relightTriangles<PhongShader>(uniforms, begin, end);
+                break;
+            default:
+                relightTriangles<FlatShader>(uniforms, begin, end);
+                break;
+        }
+    };
+    int height = image.get_height();
+    int nbands = (height + TILE_SIZE - 1) / TILE_SIZE;
+    auto resolveBand = [&](int band) {
+        resolveRows(uniforms, image, band * TILE_SIZE, std::min(height, (band + 1) * TILE_SIZE));
+    };
+    if (pool_)
+    {
+        pool_->parallelFor(nchunks, relight);
+        pool_->parallelFor(nbands, resolveBand);
+    } else
+    {
+        relight(0);
+        for (int band = 0; band < nbands; band++)
+        {
+            resolveBand(band);
+        }
+    }
+    return true;
+}
+
+void FrameRenderer::drawMultisampled(const RenderSettings &settings, TGAImage &image)
+{
+    int width = image.get_width();
+    int height = image.get_height();
+    if (!samples_ || samples_->get_width() != width || samples_->get_height() != height ||
+        samples_->get_samples() != settings.samples || samples_->get_bytespp() != image.get_bytespp())
+    {
+        samples_.reset(new SampleBuffer(width, height, settings.samples, image.get_bytespp()));
+    }
+    bool depthTest = settings.depth != DEPTH_NONE;
+    if (tiles_)
+    {
+        tiles_->draw(triangles_, image, *samples_, depthTest);
+        return;
+    }
+    samples_->clear();
+    for (size_t i = 0; i < triangles_.size(); i++)
+    {
+        rasterizeTriangle(triangles_[i].setup, *samples_, triangles_[i].varyings.color, depthTest);
+    }
+    samples_->resolve(image, 0, 0, width - 1, height - 1);
+}
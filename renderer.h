@@ -0,0 +1,201 @@
+#ifndef __RENDERER_H__
+#define __RENDERER_H__
+
+#include <memory>
+#include <vector>
+#include "depthbuffer.h"
+#include "geometry.h"
+#include "model.h"
+#include "rasterizer.h"
+#include "samplebuffer.h"
+#include "shader.h"
+#include "texture.h"
+#include "threadpool.h"
+#include "tgaimage.h"
+#include "transform.h"
+#include "visibilitybuffer.h"
+#include "wireframe.h"
+
+const int TILE_SIZE = 64;
+
+enum RasterMode
+{
+    RASTER_BARYCENTRIC, RASTER_EDGE, RASTER_WIREFRAME
+};
+
+// Models are expected to fit the [-1, 1] cube around center. The default camera looks at it
+// head on along -z with a parallel projection, which is the classic fixed view.
+struct Camera
+{
+    Vec3f eye;
+    Vec3f center;
+    Vec3f up;
+    float fov;   // vertical field of view in degrees, 0 for a parallel projection
+    float scale; // half height of the parallel view volume
+    float zNear; // clip distances from the eye; zFar <= zNear fits them around the unit cube
+    float zFar;
+
+    Camera() : eye(0, 0, 1), center(0, 0, 0), up(0, 1, 0), fov(0), scale(1), zNear(0), zFar(0)
+    {}
+
+    // the eye sits on the center or looks along the up vector
+    bool degenerate() const;
+
+    // view-projection for an image of the given size, viewport included
+    Mat4f matrix(int width, int height) const;
+};
+
+struct RenderSettings
+{
+    RasterMode raster;
+    DepthFormat depth;
+    Camera camera;
+    int samples; // 1, or 4 or 8 for multisampling with the edge rasterizer
+    ShadingMode shading;
+    const Texture *texture; // diffuse map, or null for untextured shading
+    Vec3f light;            // direction towards the light, none for a headlight at the eye
+
+    RenderSettings() : raster(RASTER_EDGE), depth(DEPTH_FLOAT), camera(), samples(1), shading(SHADING_FLAT),
+                       texture(nullptr), light()
+    {}
+
+    // unit vector towards the light
+    Vec3f lightDirection() const;
+};
+
+struct ScreenTriangle
+{
+    TriangleSetup setup;
+    Varyings varyings;       // the multisampling rasterizer only takes its color
+    ShadedRasterFunc raster; // the shader's rasterizer for single-sampled images
+};
+
+// What relighting needs of a triangle in a visibility buffer: the inputs of its vertex stage and
+// the reciprocals of their clip-space w, in the order given to setupTriangle(), and its face
+// normal. Texture coordinates are only there when textured.
+struct ShadingInputs
+{
+    ShaderVertex vertices[3];
+    float invw[3];
+    Vec3f normal;
+    bool textured;
+};
+
+// Sort-middle renderer: triangles are binned into TILE_SIZE x TILE_SIZE screen tiles and
+// every tile is rasterized by a single worker, in submission order, so the result is the
+// same as drawing the triangles one after another. Bins keep their capacity across frames.
+// Render tiles are whole HIZ_TILE squares, so workers never share depth buffer state.
+// Multisampled triangles are drawn into a SampleBuffer instead of the image; every tile clears
+// its samples first and resolves them into the image once its triangles are in.
+class TileRenderer
+{
+private:
+    // what a draw writes to: the image, its sample buffer or a visibility buffer
+    struct Target
+    {
+        int width;
+        int height;
+        TGAImage *image;
+        DepthBuffer *depth;
+        SampleBuffer *samples;
+        VisibilityBuffer *visibility;
+        const ShaderUniforms *uniforms;
+        bool depthTest;
+    };
+
+    ThreadPool &pool_;
+    std::vector<std::vector<int> > bins_; // one list per (binning chunk, tile)
+    int tilesX_;
+    int tilesY_;
+
+    void bin(const std::vector<ScreenTriangle> &triangles, int chunk, int nchunks);
+
+    void draw(const std::vector<ScreenTriangle> &triangles, const Target &target);
+
+    void drawTile(const std::vector<ScreenTriangle> &triangles, const Target &target, int tile, int nchunks);
+
+public:
+    explicit TileRenderer(ThreadPool &pool);
+
+    void draw(const std::vector<ScreenTriangle> &triangles, const ShaderUniforms &uniforms, TGAImage &image,
+              DepthBuffer *depth = nullptr);
+
+    void draw(const std::vector<ScreenTriangle> &triangles, TGAImage &image, SampleBuffer &samples, bool depthTest);
+
+    // writes the index of each triangle in triangles to the pixels it shows in
+    void draw(const std::vector<ScreenTriangle> &triangles, VisibilityBuffer &visibility, DepthBuffer *depth);
+};
+
+// Draws a shaded model into an image, lit from settings.light or by a headlight along the view
+// direction; faces turned away from the eye are culled. The image keeps the rasterizer's
+// bottom-up rows.
+// With settings.samples above one the edge rasterizer multisamples: every sample keeps its own
+// float depth, whatever settings.depth asks for, unless that is DEPTH_NONE.
+// Gouraud and Phong shading and the texture, mapped perspective-correct onto the faces with
+// texture coordinates, apply when the edge rasterizer draws without multisampling; everything
+// else is flat shaded. Faces without vertex normals are shaded with their face normal.
+// Scratch buffers are kept between frames. With a pool of more than one thread the vertices
+// are transformed in parallel and the triangles drawn by a TileRenderer, otherwise everything
+// runs on the calling thread. The model is only read, so renderers on different threads
+// may share it. RASTER_WIREFRAME draws the edges of the faces instead, through a
+// WireframeRenderer sharing the pool.
+// To light the same view in several ways, renderVisibility() rasterizes it once, with the edge
+// rasterizer and without multisampling, into a visibility buffer of triangle ids and weights.
+// Every resolve() then only runs the shaders again: the vertex stage for each visible triangle
+// and the fragment stage for each pixel, on the pool's threads.
+class FrameRenderer
+{
+private:
+    ThreadPool *pool_;
+    std::unique_ptr<TileRenderer> tiles_;
+    std::unique_ptr<DepthBuffer> depth_;
+    std::unique_ptr<SampleBuffer> samples_;
+    std::unique_ptr<VisibilityBuffer> visibility_;
+    VertexBuffer vertices_;
+    std::vector<int> corners_;       // three vertex indices per triangle of the faces
+    std::vector<int> uvCorners_;     // and their texture coordinate indices, when textured
+    std::vector<int> normalCorners_; // and their normal indices, when smooth shaded
+    std::vector<float> intensities_; // facing of every triangle towards the eye
+    std::vector<float> lighting_;    // and its lighting, when not lit from the eye
+    std::vector<ScreenTriangle> triangles_;
+    std::vector<ScreenTriangle> visibleTriangles_; // the ones the visibility buffer refers to
+    std::vector<ShadingInputs> inputs_;            // of visibleTriangles_
+    std::vector<ShadedResolveFunc> resolvers_;     // of visibleTriangles_, for the last resolve
+    const Texture *visibilityTexture_;             // what the visibility buffer was set up with
+    WireframeRenderer wireframe_;
+
+    // Builds the triangle fans of the faces, lights, culls and clips them and sets them up for
+    // a shading mode, or draws them into image with the barycentric rasterizer. With keepInputs
+    // inputs_ gets what relighting needs.
+    int setupFaces(const Model &model, const RenderSettings &settings, ShadingMode shading,
+                   const ShaderUniforms &uniforms, bool keepInputs, int width, int height, TGAImage *image);
+
+    template<template<bool> class Shader>
+    int setupTriangles(const Model &model, const RenderSettings &settings, const ShaderUniforms &uniforms,
+                       const float *lighting, bool keepInputs, int width, int height, TGAImage *image);
+
+    template<template<bool> class Shader>
+    void relightTriangles(const ShaderUniforms &uniforms, int begin, int end);
+
+    void resolveRows(const ShaderUniforms &uniforms, TGAImage &image, int y0, int y1) const;
+
+    void drawMultisampled(const RenderSettings &settings, TGAImage &image);
+
+public:
+    explicit FrameRenderer(ThreadPool *pool = nullptr);
+
+    // returns the number of triangles sent to the rasterizer, or of edges drawn in a wireframe
+    int render(const Model &model, const RenderSettings &settings, TGAImage &image);
+
+    // Rasterizes the model into the renderer's visibility buffer. Returns the number of
+    // triangles sent to the rasterizer.
+    int renderVisibility(const Model &model, const RenderSettings &settings, int width, int height);
+
+    // Shades the last visibility buffer into an image of its size with the light and shading
+    // mode of settings, whose camera must be the one it was rendered with; render() calls in
+    // between do not disturb it. Pixels where no triangle shows keep what the image holds.
+    // Returns false, drawing nothing, without a visibility buffer of the image's size.
+    bool resolve(const RenderSettings &settings, TGAImage &image);
+};
+
+#endif //__RENDERER_H__
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include "renderstats.h"
+#include "tgaimage.h"
+
+#if RENDER_STATS
+
+// Every thread counts into a block of its own, so counting takes no locked instructions; the
+// report sums the blocks of every thread that ever counted. Blocks outlive their threads.
+struct CounterBlock
+{
+    std::atomic<long long> values[COUNTER_COUNT];
+};
+
+static std::mutex blocksMutex;
+static std::vector<CounterBlock *> blocks;
+static thread_local CounterBlock *threadBlock = nullptr;
+static std::atomic<long long> stageNanoseconds[STAGE_COUNT];
+static std::vector<unsigned int> overdraw;
+static int overdrawWidth = 0;
+static int overdrawHeight = 0;
+
+static long long now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const long long startTime = now();
+
+static CounterBlock &localCounters()
+{
+    if (!threadBlock)
+    {
+        threadBlock = new CounterBlock();
+        std::lock_guard<std::mutex> lock(blocksMutex);
+        blocks.push_back(threadBlock);
+    }
+    return *threadBlock;
+}
+
+// only the owning thread writes to a block
+static inline void add(CounterBlock &block, RenderCounter counter, long long n)
+{
+    std::atomic<long long> &value = block.values[counter];
+    value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static long long total(RenderCounter counter)
+{
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    long long sum = 0;
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+        sum += blocks[i]->values[counter].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void countStat(RenderCounter counter, long long n)
+{
+    add(localCounters(), counter, n);
+}
+
+void addStageTime(RenderStage stage, long long nanoseconds)
+{
+    stageNanoseconds[stage].fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+StageTimer::StageTimer(RenderStage stage) : stage_(stage), start_(now()), running_(true)
+{}
+
+StageTimer::~StageTimer()
+{
+    stop();
+}
+
+void StageTimer::stop()
+{
+    if (running_)
+    {
+        addStageTime(stage_, now() - start_);
+        running_ = false;
+    }
+}
+
+PixelCounter::PixelCounter(int width, int height) : tested_(0), covered_(0), written_(0), overdraw_(nullptr)
+{
+    if (!overdraw.empty() && width == overdrawWidth && height == overdrawHeight)
+    {
+        overdraw_ = overdraw.data();
+    }
+}
+
+PixelCounter::~PixelCounter()
+{
+    CounterBlock &block = localCounters();
+    add(block, PIXELS_TESTED, tested_);
+    add(block, PIXELS_COVERED, covered_);
+    add(block, PIXELS_WRITTEN, written_);
+}
+
+bool enableOverdraw(int width, int height)
+{
+    overdraw.assign((size_t) width * height, 0);
+    overdrawWidth = width;
+    overdrawHeight = height;
+    return true;
+}
+
+bool writeStatsJson(const char *filename)
+{
+    const char *stages[] = {"load", "transform", "setup", "raster", "resolve", "flip", "encode", "write"};
+    const char *faces[] = {"submitted", "culled", "clipped", "rasterized"};
+    const char *pixels[] = {"tested", "covered", "written"};
+    std::ofstream out(filename);
+    if (!out.is_open())
+    {
+        std::cerr << "can't open file " << filename << "\n";
+        return false;
+    }
+    out << "{\n  \"elapsed_ms\": " << (now() - startTime) / 1e6 << ",\n  \"stages_ms\": {";
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        out << (i ? ", " : "") << "\"" << stages[i] << "\": " << stageNanoseconds[i].load() / 1e6;
+    }
+    out << "},\n  \"faces\": {";
+    for (int i = 0; i < 4; i++)
+    {
+        out << (i ? ", " : "") << "\"" << faces[i] << "\": " << total((RenderCounter) (FACES_SUBMITTED + i));
+    }
+    out << "},\n  \"pixels\": {";
+    for (int i = 0; i < 3; i++)
+    {
+        out << (i ? ", " : "") << "\"" << pixels[i] << "\": " << total((RenderCounter) (PIXELS_TESTED + i));
+    }
+    out << "},\n  \"bytes_written\": " << total(BYTES_WRITTEN);
+    if (!overdraw.empty())
+    {
+        unsigned int most = 0;
+        long long touched = 0;
+        long long writes = 0;
+        for (size_t i = 0; i < overdraw.size(); i++)
+        {
+            most = std::max(most, overdraw[i]);
+            touched += overdraw[i] > 0;
+            writes += overdraw[i];
+        }
+        // the average is over the pixels written at least once
+        out << ",\n  \"overdraw\": {\"max\": " << most << ", \"mean\": " << (touched ? (double) writes / touched : 0.)
+            << ", \"pixels\": " << touched << "}";
+    }
+    out << "\n}\n";
+    out.close();
+    if (!out.good())
+    {
+        std::cerr << "can't write " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool writeOverdrawImage(const char *filename)
+{
+    if (overdraw.empty())
+    {
+        return false;
+    }
+    const TGAColor palette[] = {TGAColor(0, 0, 0, 255), TGAColor(0, 0, 255, 255), TGAColor(0, 255, 255, 255),
+                                TGAColor(0, 255, 0, 255), TGAColor(255, 255, 0, 255), TGAColor(255, 0, 0, 255),
+                                TGAColor(255, 255, 255, 255)};
+    const unsigned int last = sizeof(palette) / sizeof(palette[0]) - 1;
+    TGAImage image(overdrawWidth, overdrawHeight, TGAImage::RGB);
+    for (int y = 0; y < overdrawHeight; y++)
+    {
+        for (int x = 0; x < overdrawWidth; x++)
+        {
+            image.set(x, y, palette[std::min(last, overdraw[(size_t) y * overdrawWidth + x])]);
+        }
+    }
+    return write_tga_file(image.view().flipped_vertically(), filename);
+}
+
+#else
+
+bool enableOverdraw(int, int)
+{
+    return false;
+}
+
+bool writeStatsJson(const char *)
+{
+    return false;
+}
+
+bool writeOverdrawImage(const char *)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef __RENDERSTATS_H__
+#define __RENDERSTATS_H__
+
+#include <cstddef>
+
+// Pipeline instrumentation: wall time per stage and counts of faces, pixels and bytes, summed
+// over the whole run. Built with RENDER_STATS 0 (make STATS=0) the timers and counters below
+// are empty inline classes and functions and cost nothing; the report functions then fail.
+#ifndef RENDER_STATS
+#define RENDER_STATS 1
+#endif
+
+const bool RENDER_STATS_ENABLED = RENDER_STATS != 0;
+
+enum RenderStage
+{
+    STAGE_LOAD, STAGE_TRANSFORM, STAGE_SETUP, STAGE_RASTER, STAGE_RESOLVE, STAGE_FLIP, STAGE_ENCODE, STAGE_WRITE,
+    STAGE_COUNT
+};
+
+enum RenderCounter
+{
+    FACES_SUBMITTED,  // triangles of the faces, polygons counted as their fans
+    FACES_CULLED,     // turned away from the light
+    FACES_CLIPPED,    // crossing the near or far plane
+    FACES_RASTERIZED, // handed to a rasterizer, which may still find them off screen or hidden
+    PIXELS_TESTED,    // coverage evaluated
+    PIXELS_COVERED,   // inside a triangle or on a line
+    PIXELS_WRITTEN,   // covered and past the depth test
+    BYTES_WRITTEN,    // to image files and streams
+    COUNTER_COUNT
+};
+
+#if RENDER_STATS
+
+void countStat(RenderCounter counter, long long n);
+
+void addStageTime(RenderStage stage, long long nanoseconds);
+
+// Adds the time from construction to stop() or destruction to a stage. Stages running on
+// several threads at once, or overlapping in a pipeline, add up to more than the elapsed time.
+class StageTimer
+{
+private:
+    RenderStage stage_;
+    long long start_;
+    bool running_;
+
+public:
+    explicit StageTimer(RenderStage stage);
+
+    ~StageTimer();
+
+    void stop();
+};
+
+// Pixel counts of one triangle or line, added to the totals when it goes out of scope. Pixels
+// are numbered y * width + x in the image being drawn; while an overdraw buffer of the image's
+// size is enabled every write also bumps the pixel's count there. Writers of disjoint pixels may
+// run on different threads.
+class PixelCounter
+{
+private:
+    long long tested_;
+    long long covered_;
+    long long written_;
+    unsigned int *overdraw_;
+
+    PixelCounter(const PixelCounter &);
+
+    PixelCounter &operator=(const PixelCounter &);
+
+public:
+    PixelCounter(int width, int height);
+
+    ~PixelCounter();
+
+    inline void test(long long n)
+    { tested_ += n; }
+
+    inline void cover(long long n)
+    { covered_ += n; }
+
+    inline void write(size_t pixel)
+    {
+        written_++;
+        if (overdraw_)
+        {
+            overdraw_[pixel]++;
+        }
+    }
+
+    // bit i of mask stands for pixel + i
+    inline void writeMask(size_t pixel, unsigned int mask)
+    {
+        written_ += __builtin_popcount(mask);
+        for (; overdraw_ && mask; mask &= mask - 1)
+        {
+            overdraw_[pixel + __builtin_ctz(mask)]++;
+        }
+    }
+};
+
+#else
+
+inline void countStat(RenderCounter, long long)
+{}
+
+inline void addStageTime(RenderStage, long long)
+{}
+
+class StageTimer
+{
+public:
+    explicit StageTimer(RenderStage)
+    {}
+
+    inline void stop()
+    {}
+};
+
+class PixelCounter
+{
+public:
+    PixelCounter(int, int)
+    {}
+
+    inline void test(long long)
+    {}
+
+    inline void cover(long long)
+    {}
+
+    inline void write(size_t)
+    {}
+
+    inline void writeMask(size_t, unsigned int)
+    {}
+};
+
+#endif
+
+// Starts counting the writes to every pixel of images of this size, for writeOverdrawImage().
+// Overdraw must only be enabled while a single image is drawn at a time.
+bool enableOverdraw(int width, int height);
+
+// Writes the stage times in milliseconds, the counters and, if enabled, the overdraw summary
+// as a JSON object.
+bool writeStatsJson(const char *filename);
+
+// Writes the overdraw counts as a heat map, rows flipped like the rendered image: black where
+// nothing was written, then blue, cyan, green, yellow, red and white from 6 writes up.
+bool writeOverdrawImage(const char *filename);
+
+#endif //__RENDERSTATS_H__
@@ -0,0 +1,366 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "resample.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// rows per parallel band
+const int RESAMPLE_BAND_ROWS = 16;
+
+// Source pixels behind every destination pixel along one axis: pixel i is the weighted sum of
+// count[i] source pixels from first[i] on, with its weights at i * taps.
+struct FilterTaps
+{
+    std::vector<int> first;
+    std::vector<int> count;
+    std::vector<float> weights;
+    int taps;
+};
+
+static double filterSupport(ResampleFilter filter)
+{
+    switch (filter)
+    {
+        case FILTER_BOX:
+            return 0.5;
+        case FILTER_BILINEAR:
+            return 1.0;
+        default:
+            return 3.0;
+    }
+}
+
+static double sinc(double x)
+{
+    if (x == 0)
+    {
+        return 1;
+    }
+    x *= M_PI;
+    return sin(x) / x;
+}
+
+static double filterWeight(ResampleFilter filter, double x)
+{
+    switch (filter)
+    {
+        case FILTER_BOX:
+            return x >= -0.5 && x < 0.5 ? 1 : 0;
+        case FILTER_BILINEAR:
+            x = fabs(x);
+            return x < 1 ? 1 - x : 0;
+        default:
+            return fabs(x) < 3 ? sinc(x) * sinc(x / 3) : 0;
+    }
+}
+
+static void computeTaps(int srcSize, int dstSize, ResampleFilter filter, FilterTaps &taps)
+{
+    double scale = (double) srcSize / dstSize;
+    double stretch = std::max(scale, 1.0);
+    double support = filterSupport(filter) * stretch;
+    taps.taps = (int) ceil(support) * 2 + 1;
+    taps.first.resize(dstSize);
+    taps.count.resize(dstSize);
+    taps.weights.assign((size_t) dstSize * taps.taps, 0.f);
+    std::vector<double> w(taps.taps);
+    for (int i = 0; i < dstSize; i++)
+    {
+        double center = (i + 0.5) * scale;
+        int x0 = std::max((int) floor(center - support + 0.5), 0);
+        int x1 = std::min(std::min((int) floor(center + support + 0.5), srcSize), x0 + taps.taps);
+        double total = 0;
+        for (int x = x0; x < x1; x++)
+        {
+            w[x - x0] = filterWeight(filter, (x + 0.5 - center) / stretch);
+            total += w[x - x0];
+        }
+        if (total == 0)
+        {
+            // nothing under the filter, take the nearest pixel
+            x0 = std::min((int) center, srcSize - 1);
+            x1 = x0 + 1;
+            w[0] = total = 1;
+        }
+        taps.first[i] = x0;
+        taps.count[i] = x1 - x0;
+        for (int x = x0; x < x1; x++)
+        {
+            taps.weights[(size_t) i * taps.taps + x - x0] = (float) (w[x - x0] / total);
+        }
+    }
+}
+
+static void forBands(int rows, ThreadPool *pool, const std::function<void(int, int)> &task)
+{
+    int nbands = (rows + RESAMPLE_BAND_ROWS - 1) / RESAMPLE_BAND_ROWS;
+    auto band = [&](int b) {
+        task(b * RESAMPLE_BAND_ROWS, std::min(rows, (b + 1) * RESAMPLE_BAND_ROWS));
+    };
+    if (pool && nbands > 1)
+    {
+        pool->parallelFor(nbands, band);
+    } else
+    {
+        for (int b = 0; b < nbands; b++)
+        {
+            band(b);
+        }
+    }
+}
+
+// horizontal pass over one source row
+template<int BPP>
+static void filterRow(const unsigned char *in, long pixelStride, const FilterTaps &taps, int width, float *out)
+{
+    for (int i = 0; i < width; i++, out += BPP)
+    {
+        const float *w = &taps.weights[(size_t) i * taps.taps];
+        const unsigned char *p = in + taps.first[i] * pixelStride;
+        float sum[BPP] = {};
+        for (int k = 0; k < taps.count[i]; k++, p += pixelStride)
+        {
+            for (int c = 0; c < BPP; c++)
+            {
+                sum[c] += w[k] * p[c];
+            }
+        }
+        for (int c = 0; c < BPP; c++)
+        {
+            out[c] = sum[c];
+        }
+    }
+}
+
+#ifdef __SSE2__
+// four channels fill a register, one tap per step
+template<>
+void filterRow<4>(const unsigned char *in, long pixelStride, const FilterTaps &taps, int width, float *out)
+{
+    __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < width; i++, out += 4)
+    {
+        const float *w = &taps.weights[(size_t) i * taps.taps];
+        const unsigned char *p = in + taps.first[i] * pixelStride;
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < taps.count[i]; k++, p += pixelStride)
+        {
+            int pixel;
+            memcpy(&pixel, p, 4);
+            __m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero), zero);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(w[k])));
+        }
+        _mm_storeu_ps(out, sum);
+    }
+}
+#endif
+
+static inline unsigned char clampByte(float v)
+{
+    return (unsigned char) std::min(std::max(v + 0.5f, 0.f), 255.f);
+}
+
+// vertical pass: one destination row from count rows of the float buffer
+static void filterColumns(const float *const *rows, const float *w, int count, int n, unsigned char *out)
+{
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128 s0 = _mm_setzero_ps();
+        __m128 s1 = _mm_setzero_ps();
+        __m128 s2 = _mm_setzero_ps();
+        __m128 s3 = _mm_setzero_ps();
+        for (int k = 0; k < count; k++)
+        {
+            __m128 wk = _mm_set1_ps(w[k]);
+            const float *row = rows[k] + i;
+            s0 = _mm_add_ps(s0, _mm_mul_ps(wk, _mm_loadu_ps(row)));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(wk, _mm_loadu_ps(row + 4)));
+            s2 = _mm_add_ps(s2, _mm_mul_ps(wk, _mm_loadu_ps(row + 8)));
+            s3 = _mm_add_ps(s3, _mm_mul_ps(wk, _mm_loadu_ps(row + 12)));
+        }
+        // round half up like clampByte: add 0.5 and truncate, which only differs from flooring for
+        // sums below -0.5 that the saturating packs clamp to 0 anyway, as they clamp the top to 255
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128i lo = _mm_packs_epi32(_mm_cvttps_epi32(_mm_add_ps(s0, half)), _mm_cvttps_epi32(_mm_add_ps(s1, half)));
+        __m128i hi = _mm_packs_epi32(_mm_cvttps_epi32(_mm_add_ps(s2, half)), _mm_cvttps_epi32(_mm_add_ps(s3, half)));
+        _mm_storeu_si128((__m128i *) (out + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        float sum = 0;
+        for (int k = 0; k < count; k++)
+        {
+            sum += w[k] * rows[k][i];
+        }
+        out[i] = clampByte(sum);
+    }
+}
+
+// copies a row of packed pixels into a destination row, which may run backwards
+static void storeRow(const unsigned char *line, const ImageView &dst, int y)
+{
+    unsigned char *out = dst.pixel(0, y);
+    for (int x = 0; x < dst.width; x++, line += dst.bytespp, out += dst.pixelStride)
+    {
+        memcpy(out, line, dst.bytespp);
+    }
+}
+
+bool resample(const ImageView &src, const ImageView &dst, ResampleFilter filter, ThreadPool *pool)
+{
+    if (!src.origin || !dst.origin || src.bytespp != dst.bytespp || dst.width <= 0 || dst.height <= 0)
+    {
+        return false;
+    }
+    for (int factor = 2; factor <= 4 && filter == FILTER_BOX; factor *= 2)
+    {
+        if (src.width == dst.width * factor && src.height == dst.height * factor && src.pixelStride > 0 &&
+            dst.pixelStride > 0)
+        {
+            return downsampleBox(src, dst, factor, pool);
+        }
+    }
+    int bytespp = src.bytespp;
+    FilterTaps xtaps;
+    FilterTaps ytaps;
+    computeTaps(src.width, dst.width, filter, xtaps);
+    computeTaps(src.height, dst.height, filter, ytaps);
+    size_t lineFloats = (size_t) dst.width * bytespp;
+    std::vector<float> buffer(lineFloats * src.height);
+
+    forBands(src.height, pool, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++)
+        {
+            float *out = buffer.data() + y * lineFloats;
+            switch (bytespp)
+            {
+                case TGAImage::GRAYSCALE:
+                    filterRow<1>(src.pixel(0, y), src.pixelStride, xtaps, dst.width, out);
+                    break;
+                case TGAImage::RGB:
+                    filterRow<3>(src.pixel(0, y), src.pixelStride, xtaps, dst.width, out);
+                    break;
+                default:
+                    filterRow<4>(src.pixel(0, y), src.pixelStride, xtaps, dst.width, out);
+                    break;
+            }
+        }
+    });
+    forBands(dst.height, pool, [&](int y0, int y1) {
+        std::vector<const float *> rows(ytaps.taps);
+        std::vector<unsigned char> line(dst.pixelStride > 0 ? 0 : lineFloats);
+        for (int y = y0; y < y1; y++)
+        {
+            for (int k = 0; k < ytaps.count[y]; k++)
+            {
+                rows[k] = buffer.data() + (ytaps.first[y] + k) * lineFloats;
+            }
+            unsigned char *out = dst.pixelStride > 0 ? dst.pixel(0, y) : line.data();
+            filterColumns(rows.data(), &ytaps.weights[(size_t) y * ytaps.taps], ytaps.count[y], lineFloats, out);
+            if (dst.pixelStride < 0)
+            {
+                storeRow(line.data(), dst, y);
+            }
+        }
+    });
+    return true;
+}
+
+// Adds up factor rows of n bytes into 16 bit sums.
+static void sumRows(const ImageView &src, int y, int factor, int n, unsigned short *sums)
+{
+    int i = 0;
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i lo = _mm_setzero_si128();
+        __m128i hi = _mm_setzero_si128();
+        for (int j = 0; j < factor; j++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *) (src.pixel(0, y + j) + i));
+            lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+            hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+        }
+        _mm_storeu_si128((__m128i *) (sums + i), lo);
+        _mm_storeu_si128((__m128i *) (sums + i + 8), hi);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        unsigned short sum = 0;
+        for (int j = 0; j < factor; j++)
+        {
+            sum += src.pixel(0, y + j)[i];
+        }
+        sums[i] = sum;
+    }
+}
+
+template<int BPP, int FACTOR>
+static void boxRow(const unsigned short *sums, int width, unsigned char *out)
+{
+    for (int x = 0; x < width; x++, sums += FACTOR * BPP, out += BPP)
+    {
+        for (int c = 0; c < BPP; c++)
+        {
+            unsigned sum = 0;
+            for (int j = 0; j < FACTOR; j++)
+            {
+                sum += sums[j * BPP + c];
+            }
+            out[c] = (unsigned char) ((sum + FACTOR * FACTOR / 2) / (FACTOR * FACTOR));
+        }
+    }
+}
+
+template<int FACTOR>
+static void boxRow(const unsigned short *sums, int width, int bytespp, unsigned char *out)
+{
+    switch (bytespp)
+    {
+        case TGAImage::GRAYSCALE:
+            boxRow<1, FACTOR>(sums, width, out);
+            break;
+        case TGAImage::RGB:
+            boxRow<3, FACTOR>(sums, width, out);
+            break;
+        default:
+            boxRow<4, FACTOR>(sums, width, out);
+            break;
+    }
+}
+
+bool downsampleBox(const ImageView &src, const ImageView &dst, int factor, ThreadPool *pool)
+{
+    if (!src.origin || !dst.origin || src.bytespp != dst.bytespp || (factor != 2 && factor != 4) ||
+        src.width != dst.width * factor || src.height != dst.height * factor || src.pixelStride < 0 ||
+        dst.pixelStride < 0)
+    {
+        return false;
+    }
+    int n = src.width * src.bytespp;
+    forBands(dst.height, pool, [&](int y0, int y1) {
+        std::vector<unsigned short> sums(n);
+        for (int y = y0; y < y1; y++)
+        {
+            sumRows(src, y * factor, factor, n, sums.data());
+            if (factor == 2)
+            {
+                boxRow<2>(sums.data(), dst.width, dst.bytespp, dst.pixel(0, y));
+            } else
+            {
+                boxRow<4>(sums.data(), dst.width, dst.bytespp, dst.pixel(0, y));
+            }
+        }
+    });
+    return true;
+}
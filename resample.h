@@ -0,0 +1,20 @@
+#ifndef __RESAMPLE_H__
+#define __RESAMPLE_H__
+
+#include "threadpool.h"
+#include "tgaimage.h"
+
+// Resamples src into dst, whose size and orientation are taken from the views; both need the
+// same number of bytes per pixel. The filter is applied as two separable passes, rows into a
+// float buffer and then columns into dst, and is stretched by the scale factor when
+// shrinking so every source pixel contributes. Lanczos may overshoot, results are clamped.
+// With a pool both passes are split into bands of rows that run in parallel.
+// Exact 2x and 4x box reductions take the integer path of downsampleBox().
+bool resample(const ImageView &src, const ImageView &dst, ResampleFilter filter, ThreadPool *pool = nullptr);
+
+// Averages factor x factor blocks of src into dst, rounding to nearest. dst must be exactly
+// factor times smaller than src in both directions; factor is 2 or 4. Source rows are summed
+// 16 bytes at a time whatever the format, so neither view may be mirrored.
+bool downsampleBox(const ImageView &src, const ImageView &dst, int factor, ThreadPool *pool = nullptr);
+
+#endif //__RESAMPLE_H__
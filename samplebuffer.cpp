@@ -0,0 +1,90 @@
+#include <cstring>
+#include "samplebuffer.h"
+
+SampleBuffer::SampleBuffer(int w, int h, int samples, int bytespp) : width_(w), height_(h), samples_(samples),
+                                                                     bytespp_(bytespp), colors_(), depths_()
+{
+    size_t nsamples = (size_t) w * h * samples;
+    colors_.resize(nsamples * bytespp);
+    depths_.resize(nsamples);
+}
+
+int SampleBuffer::get_width() const
+{
+    return width_;
+}
+
+int SampleBuffer::get_height() const
+{
+    return height_;
+}
+
+int SampleBuffer::get_samples() const
+{
+    return samples_;
+}
+
+int SampleBuffer::get_bytespp() const
+{
+    return bytespp_;
+}
+
+unsigned char *SampleBuffer::colors()
+{
+    return colors_.data();
+}
+
+float *SampleBuffer::depths()
+{
+    return depths_.data();
+}
+
+void SampleBuffer::clear()
+{
+    memset(colors_.data(), 0, colors_.size());
+    memset(depths_.data(), 0, depths_.size() * sizeof(float));
+}
+
+void SampleBuffer::clear(int x0, int y0, int x1, int y1)
+{
+    size_t n = (size_t) (x1 - x0 + 1) * samples_;
+    for (int y = y0; y <= y1; y++)
+    {
+        size_t first = ((size_t) y * width_ + x0) * samples_;
+        memset(colors_.data() + first * bytespp_, 0, n * bytespp_);
+        memset(depths_.data() + first, 0, n * sizeof(float));
+    }
+}
+
+void SampleBuffer::resolve(TGAImage &image, int x0, int y0, int x1, int y1) const
+{
+    size_t pixelBytes = (size_t) samples_ * bytespp_;
+    for (int y = y0; y <= y1; y++)
+    {
+        const unsigned char *in = colors_.data() + ((size_t) y * width_ + x0) * pixelBytes;
+        unsigned char *out = image.buffer() + ((size_t) y * width_ + x0) * bytespp_;
+        for (int x = x0; x <= x1; x++, in += pixelBytes, out += bytespp_)
+        {
+            // pixels inside a triangle or in the background have all samples alike
+            bool uniform = true;
+            for (int s = 1; s < samples_ && uniform; s++)
+            {
+                uniform = !memcmp(in, in + s * bytespp_, bytespp_);
+            }
+            if (uniform)
+            {
+                memcpy(out, in, bytespp_);
+                continue;
+            }
+            for (int c = 0; c < bytespp_; c++)
+            {
+                unsigned sum = samples_ / 2;
+                for (int s = 0; s < samples_; s++)
+                {
+                    sum += in[s * bytespp_ + c];
+                }
+                out[c] = (unsigned char) (sum / samples_);
+            }
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef __SAMPLEBUFFER_H__
+#define __SAMPLEBUFFER_H__
+
+#include <vector>
+#include "tgaimage.h"
+
+const int MAX_SAMPLES = 8;
+
+// Colour and depth of every sample of a multisampled frame, the samples of a pixel side by
+// side: sample s of pixel (x, y) is entry (y * width + x) * samples + s. Depth is always
+// float, larger values are closer as in DepthBuffer, and clearing sets colours and depths to 0.
+// Callers touching disjoint pixels may use the buffer from different threads.
+class SampleBuffer
+{
+private:
+    int width_;
+    int height_;
+    int samples_;
+    int bytespp_;
+    std::vector<unsigned char> colors_;
+    std::vector<float> depths_;
+
+public:
+    SampleBuffer(int w, int h, int samples, int bytespp);
+
+    int get_width() const;
+
+    int get_height() const;
+
+    int get_samples() const;
+
+    int get_bytespp() const;
+
+    unsigned char *colors();
+
+    float *depths();
+
+    void clear();
+
+    // clears the pixels of [x0, x1] x [y0, y1], inclusive
+    void clear(int x0, int y0, int x1, int y1);
+
+    // writes the average of the samples of every pixel of [x0, x1] x [y0, y1] into image,
+    // which must be as large as the buffer and have the same format
+    void resolve(TGAImage &image, int x0, int y0, int x1, int y1) const;
+};
+
+#endif //__SAMPLEBUFFER_H__
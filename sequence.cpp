@@ -0,0 +1,167 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "boundedqueue.h"
+#include "renderstats.h"
+#include "sequence.h"
+
+bool validFramePattern(const char *pattern)
+{
+    int conversions = 0;
+    for (const char *p = pattern; *p; p++)
+    {
+        if (*p != '%')
+        {
+            continue;
+        }
+        p++;
+        if (*p == '%')
+        {
+            continue;
+        }
+        while (*p >= '0' && *p <= '9')
+        {
+            p++;
+        }
+        if (*p != 'd')
+        {
+            return false;
+        }
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+Camera orbitCamera(const Camera &camera, float angle)
+{
+    Vec3f k = camera.up;
+    k.normalize();
+    Vec3f v = camera.eye - camera.center;
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    Camera r = camera;
+    r.eye = camera.center + v * c + cross(k, v) * s + k * ((k * v) * (1 - c));
+    return r;
+}
+
+struct SequenceFrame
+{
+    int index;
+    TGAImage image;
+
+    SequenceFrame(int w, int h, FramePool &frames) : index(0), image(w, h, TGAImage::RGB, &frames)
+    {}
+};
+
+struct EncodedFrame
+{
+    int index;
+    std::vector<unsigned char> bytes; // the whole file, empty if encoding failed
+};
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int renderSequence(const Model &model, const RenderSettings &settings, int width, int height, int frames,
+                   const char *pattern, FrameSink *sink, ThreadPool &pool, FramePool &framePool)
+{
+    auto sequenceStart = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<SequenceFrame> > buffers;
+    BoundedQueue<SequenceFrame *> idle(SEQUENCE_FRAMES);
+    BoundedQueue<SequenceFrame *> rendered(SEQUENCE_FRAMES);
+    BoundedQueue<EncodedFrame> encoded(SEQUENCE_FRAMES);
+    for (int i = 0; i < SEQUENCE_FRAMES; i++)
+    {
+        buffers.push_back(std::unique_ptr<SequenceFrame>(new SequenceFrame(width, height, framePool)));
+        idle.push(buffers.back().get());
+    }
+    double encodeMs = 0;
+    double writeMs = 0;
+    int failed = 0;
+
+    std::thread encoder([&] {
+        SequenceFrame *frame;
+        while (rendered.pop(frame))
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (sink)
+            {
+                failed += sink->write(frame->image.view().flipped_vertically()) ? 0 : 1;
+                idle.push(frame);
+                writeMs += millisecondsSince(start);
+                continue;
+            }
+            EncodedFrame encodedFrame;
+            encodedFrame.index = frame->index;
+            if (!encode_tga(frame->image.view().flipped_vertically(), encodedFrame.bytes))
+            {
+                encodedFrame.bytes.clear();
+            }
+            idle.push(frame);
+            encodeMs += millisecondsSince(start);
+            encoded.push(std::move(encodedFrame));
+        }
+        encoded.close();
+    });
+    std::thread writer([&] {
+        EncodedFrame encodedFrame;
+        std::vector<char> filename(std::string(pattern).size() + 32);
+        while (encoded.pop(encodedFrame))
+        {
+            auto start = std::chrono::steady_clock::now();
+            snprintf(filename.data(), filename.size(), pattern, encodedFrame.index);
+            if (encodedFrame.bytes.empty())
+            {
+                // leave whatever is on disk alone rather than truncating it
+                std::cerr << "can't encode frame " << filename.data() << "\n";
+                failed++;
+                writeMs += millisecondsSince(start);
+                continue;
+            }
+            StageTimer timer(STAGE_WRITE);
+            std::ofstream out(filename.data(), std::ios::binary);
+            out.write((char *) encodedFrame.bytes.data(), encodedFrame.bytes.size());
+            out.close();
+            timer.stop();
+            if (!out)
+            {
+                std::cerr << "can't write frame " << filename.data() << "\n";
+                failed++;
+            } else
+            {
+                countStat(BYTES_WRITTEN, (long long) encodedFrame.bytes.size());
+            }
+            writeMs += millisecondsSince(start);
+        }
+    });
+
+    FrameRenderer renderer(&pool);
+    RenderSettings frameSettings = settings;
+    double renderMs = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        SequenceFrame *frame = nullptr;
+        idle.pop(frame);
+        auto start = std::chrono::steady_clock::now();
+        frame->index = i;
+        frame->image.clear();
+        frameSettings.camera = orbitCamera(settings.camera, 2 * (float) M_PI * i / frames);
+        renderer.render(model, frameSettings, frame->image);
+        renderMs += millisecondsSince(start);
+        rendered.push(frame);
+    }
+    rendered.close();
+    encoder.join();
+    writer.join();
+    std::cerr << "# frames " << frames << " render " << renderMs << " ms encode " << encodeMs << " ms write "
+              << writeMs << " ms wall " << millisecondsSince(sequenceStart) << " ms" << std::endl;
+    return failed;
+}
@@ -0,0 +1,30 @@
+#ifndef __SEQUENCE_H__
+#define __SEQUENCE_H__
+
+#include "framepool.h"
+#include "framesink.h"
+#include "model.h"
+#include "renderer.h"
+#include "threadpool.h"
+
+// frame buffers shared by the render and encode stages
+const int SEQUENCE_FRAMES = 3;
+
+// An output pattern holds exactly one %d conversion, optionally zero padded ("frame%04d.tga").
+bool validFramePattern(const char *pattern);
+
+// The eye of camera turned by angle radians around the up axis through the center.
+Camera orbitCamera(const Camera &camera, float angle);
+
+// Renders a turntable of frames images: the eye makes one full turn around the model starting
+// from settings.camera, and frame i is written to pattern formatted with i. Rasterization runs
+// on the calling thread and the pool while a second thread encodes finished frames
+// and a third writes them out. The stages are connected by bounded queues, so at most
+// SEQUENCE_FRAMES images, borrowed from framePool, are in flight and they are reused rather than
+// allocated per frame.
+// With a sink the frames are streamed to it in order from the second thread instead, and
+// pattern is not used. Returns the number of frames that could not be written.
+int renderSequence(const Model &model, const RenderSettings &settings, int width, int height, int frames,
+                   const char *pattern, FrameSink *sink, ThreadPool &pool, FramePool &framePool);
+
+#endif //__SEQUENCE_H__
@@ -0,0 +1,157 @@
+#ifndef __SHADER_H__
+#define __SHADER_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "geometry.h"
+#include "texture.h"
+#include "tgaimage.h"
+
+// Shaders are classes handed to setupVaryings(), rasterizeShaded() and resolveShaded() as template
+// arguments, so every shader gets a pixel loop of its own with both stages inlined. A shader has
+//   TEXTURED   true if it samples uniforms.texture, with the texture coordinates in varyings 0, 1
+//   VARYINGS   how many floats its vertex stage passes on, at most MAX_VARYINGS
+//   vertex()   the vertex stage, which computes the varyings of a triangle corner
+//   fragment() the fragment stage, which computes the BGRA colour of a pixel from the varyings
+//              interpolated there
+// Vertex positions are not part of it: transformVertices() projects all of them in one go.
+const int MAX_VARYINGS = 5;
+
+enum ShadingMode
+{
+    SHADING_FLAT, SHADING_GOURAUD, SHADING_PHONG
+};
+
+// What every triangle of a frame shares.
+struct ShaderUniforms
+{
+    Vec3f light;            // unit vector from the surface towards the light
+    const Texture *texture; // sampled by textured shaders
+};
+
+// The attributes of a triangle corner that the vertex stage reads.
+struct ShaderVertex
+{
+    Vec3f normal; // unit length, facing out of the surface
+    Vec2f uv;
+};
+
+// Vertex stage outputs of a triangle in the vertex order of its TriangleSetup, divided by the
+// clip-space w for perspective-correct interpolation, and what a shader keeps per triangle.
+struct Varyings
+{
+    float value[3][MAX_VARYINGS];
+    float q[3];     // 1 / w at the vertices
+    TGAColor color; // grey of the lighting of the whole face
+    int level;      // mip level of the texture
+};
+
+// Writes a surface lit with the given grey level: the grey itself, or the texel at uv modulated
+// by it.
+template<bool Textured>
+inline void shadeSurface(const ShaderUniforms &uniforms, const Varyings &varyings, const float *uv,
+                         unsigned char light, unsigned char *out)
+{
+    if (Textured)
+    {
+        uint32_t texel = uniforms.texture->sample(varyings.level, uv[0], uv[1]);
+        const unsigned char *t = (const unsigned char *) &texel;
+        for (int c = 0; c < 3; c++)
+        {
+            out[c] = (unsigned char) ((t[c] * light + 127) / 255);
+        }
+        out[3] = t[3];
+    } else
+    {
+        out[0] = out[1] = out[2] = light;
+        out[3] = 255;
+    }
+}
+
+inline unsigned char lightLevel(float intensity)
+{
+    return (unsigned char) (std::min(1.f, std::max(0.f, intensity)) * 255);
+}
+
+// One light level per face, the classic look.
+template<bool Textured>
+struct FlatShader
+{
+    static const bool TEXTURED = Textured;
+    static const int VARYINGS = Textured ? 2 : 0;
+
+    static inline void vertex(const ShaderUniforms &, const ShaderVertex &in, float *out)
+    {
+        if (Textured)
+        {
+            out[0] = in.uv.x;
+            out[1] = in.uv.y;
+        }
+    }
+
+    static inline void fragment(const ShaderUniforms &uniforms, const Varyings &varyings, const float *in,
+                                unsigned char *out)
+    { shadeSurface<Textured>(uniforms, varyings, in, varyings.color.bgra[0], out); }
+};
+
+// Diffuse lighting at the vertices from their normals, interpolated across the face.
+template<bool Textured>
+struct GouraudShader
+{
+    static const bool TEXTURED = Textured;
+    static const int VARYINGS = Textured ? 3 : 1;
+
+    static inline void vertex(const ShaderUniforms &uniforms, const ShaderVertex &in, float *out)
+    {
+        FlatShader<Textured>::vertex(uniforms, in, out);
+        out[VARYINGS - 1] = std::max(0.f, in.normal * uniforms.light);
+    }
+
+    static inline void fragment(const ShaderUniforms &uniforms, const Varyings &varyings, const float *in,
+                                unsigned char *out)
+    { shadeSurface<Textured>(uniforms, varyings, in, lightLevel(in[VARYINGS - 1]), out); }
+};
+
+// Diffuse lighting at every pixel from the interpolated vertex normal.
+template<bool Textured>
+struct PhongShader
+{
+    static const bool TEXTURED = Textured;
+    static const int VARYINGS = Textured ? 5 : 3;
+
+    static inline void vertex(const ShaderUniforms &uniforms, const ShaderVertex &in, float *out)
+    {
+        FlatShader<Textured>::vertex(uniforms, in, out);
+        out[VARYINGS - 3] = in.normal.x;
+        out[VARYINGS - 2] = in.normal.y;
+        out[VARYINGS - 1] = in.normal.z;
+    }
+
+    static inline void fragment(const ShaderUniforms &uniforms, const Varyings &varyings, const float *in,
+                                unsigned char *out)
+    {
+        Vec3f normal(in[VARYINGS - 3], in[VARYINGS - 2], in[VARYINGS - 1]);
+        float length = normal.norm();
+        float intensity = length > 0 ? normal * uniforms.light / length : 0.f;
+        shadeSurface<Textured>(uniforms, varyings, in, lightLevel(intensity), out);
+    }
+};
+
+// Runs the fragment stage of a shader at the point with barycentric weights w0, w1 and w2, or any
+// positive multiple of them, which cancels out in the ratio of the interpolated varyings / w to
+// 1 / w.
+template<class Shader>
+inline void shadeFragment(const Varyings &varyings, const ShaderUniforms &uniforms, float w0, float w1, float w2,
+                          unsigned char *color)
+{
+    float q = 1.f / (w0 * varyings.q[0] + w1 * varyings.q[1] + w2 * varyings.q[2]);
+    float in[MAX_VARYINGS];
+    for (int i = 0; i < Shader::VARYINGS; i++)
+    {
+        in[i] = (w0 * varyings.value[0][i] + w1 * varyings.value[1][i] + w2 * varyings.value[2][i]) * q;
+    }
+    Shader::fragment(uniforms, varyings, in, color);
+}
+
+#endif //__SHADER_H__
@@ -0,0 +1,106 @@
+#include <cstring>
+#include <iostream>
+#include "renderstats.h"
+#include "texture.h"
+
+Texture::Texture() : texels_(), levels_()
+{}
+
+void Texture::addLevel(TGAImage &image)
+{
+    Level level;
+    level.width = image.get_width();
+    level.height = image.get_height();
+    level.tilesX = (level.width + TEXTURE_TILE - 1) / TEXTURE_TILE;
+    level.offset = texels_.size();
+    int tilesY = (level.height + TEXTURE_TILE - 1) / TEXTURE_TILE;
+    texels_.resize(level.offset + ((size_t) level.tilesX * tilesY << (2 * TEXTURE_TILE_BITS)));
+    levels_.push_back(level);
+    const unsigned char *row = image.buffer();
+    for (int y = 0; y < level.height; y++, row += (size_t) level.width * 4)
+    {
+        for (int x = 0; x < level.width; x++)
+        {
+            uint32_t texel;
+            memcpy(&texel, row + x * 4, 4);
+            size_t tile = (size_t) (y >> TEXTURE_TILE_BITS) * level.tilesX + (x >> TEXTURE_TILE_BITS);
+            texels_[level.offset + (tile << (2 * TEXTURE_TILE_BITS)) +
+                    morton(x & (TEXTURE_TILE - 1), y & (TEXTURE_TILE - 1))] = texel;
+        }
+    }
+}
+
+bool Texture::load(const char *filename, ThreadPool *pool)
+{
+    StageTimer timer(STAGE_LOAD);
+    TGAImage image;
+    if (!image.read_tga_file(filename))
+    {
+        return false;
+    }
+    return build(image, pool);
+}
+
+bool Texture::build(TGAImage &image, ThreadPool *pool)
+{
+    texels_.clear();
+    levels_.clear();
+    int width = image.get_width();
+    int height = image.get_height();
+    int bytespp = image.get_bytespp();
+    if (width <= 0 || height <= 0 || !image.buffer())
+    {
+        return false;
+    }
+    // every format becomes BGRA, opaque unless it has alpha
+    TGAImage level(width, height, TGAImage::RGBA);
+    const unsigned char *in = image.buffer();
+    unsigned char *out = level.buffer();
+    for (size_t i = 0; i < (size_t) width * height; i++, in += bytespp, out += 4)
+    {
+        out[0] = in[0];
+        out[1] = bytespp >= 3 ? in[1] : in[0];
+        out[2] = bytespp >= 3 ? in[2] : in[0];
+        out[3] = bytespp == 4 ? in[3] : 255;
+    }
+    addLevel(level);
+    while (width > 1 || height > 1)
+    {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        level.scale(width, height, FILTER_BOX, pool);
+        addLevel(level);
+    }
+    return true;
+}
+
+bool Texture::good() const
+{
+    return !levels_.empty();
+}
+
+int Texture::levels() const
+{
+    return (int) levels_.size();
+}
+
+int Texture::width(int level) const
+{
+    return levels_[level].width;
+}
+
+int Texture::height(int level) const
+{
+    return levels_[level].height;
+}
+
+int Texture::selectLevel(float texelArea, float pixelArea) const
+{
+    if (!(texelArea > pixelArea) || levels_.size() < 2)
+    {
+        return 0;
+    }
+    // every level down divides the texel area by four
+    float lod = 0.5f * std::log2(texelArea / pixelArea);
+    return std::min((int) (lod + 0.5f), (int) levels_.size() - 1);
+}
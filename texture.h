@@ -0,0 +1,88 @@
+#ifndef __TEXTURE_H__
+#define __TEXTURE_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "tgaimage.h"
+#include "threadpool.h"
+
+// Texels per side of a texture tile: 8 x 8 BGRA texels make 256 bytes, four cache lines.
+const int TEXTURE_TILE_BITS = 3;
+const int TEXTURE_TILE = 1 << TEXTURE_TILE_BITS;
+
+// Diffuse texture kept as a mip chain of BGRA texels. Every level is cut into TEXTURE_TILE
+// squares stored one after another, row by row, with the texels of a tile in Z (Morton) order,
+// so texels close in both directions are close in memory whichever way a triangle walks them.
+// Level 0 is the image, padded to whole tiles; every further level is a box-filtered half of
+// the one before, down to 1 x 1. Texture coordinates repeat, and v runs up the image as in OBJ
+// files. Immutable once built, so renderers on different threads may share it.
+class Texture
+{
+private:
+    struct Level
+    {
+        int width;
+        int height;
+        int tilesX;
+        size_t offset; // of its first texel in texels_
+    };
+
+    std::vector<uint32_t> texels_;
+    std::vector<Level> levels_;
+
+    // Z order of the low TEXTURE_TILE_BITS bits of x and y, x in the even bits
+    static inline uint32_t morton(uint32_t x, uint32_t y)
+    {
+        x = (x | (x << 2)) & 0x33;
+        x = (x | (x << 1)) & 0x55;
+        y = (y | (y << 2)) & 0x33;
+        y = (y | (y << 1)) & 0x55;
+        return x | (y << 1);
+    }
+
+    void addLevel(TGAImage &image);
+
+public:
+    Texture();
+
+    // Reads a TGA file of any format through TGAImage::read_tga_file and builds the chain.
+    bool load(const char *filename, ThreadPool *pool = nullptr);
+
+    // Builds the chain from an image, top row first; the image is left unchanged.
+    bool build(TGAImage &image, ThreadPool *pool = nullptr);
+
+    bool good() const;
+
+    int levels() const;
+
+    int width(int level) const;
+
+    int height(int level) const;
+
+    // The level a triangle covering texelArea texels of level 0 on pixelArea screen pixels
+    // samples: the one closest to a texel per pixel.
+    int selectLevel(float texelArea, float pixelArea) const;
+
+    inline uint32_t fetch(int level, int x, int y) const
+    {
+        const Level &l = levels_[level];
+        size_t tile = (size_t) (y >> TEXTURE_TILE_BITS) * l.tilesX + (x >> TEXTURE_TILE_BITS);
+        return texels_[l.offset + (tile << (2 * TEXTURE_TILE_BITS)) + morton(x & (TEXTURE_TILE - 1),
+                                                                              y & (TEXTURE_TILE - 1))];
+    }
+
+    // nearest texel of a level, BGRA in memory order
+    inline uint32_t sample(int level, float u, float v) const
+    {
+        const Level &l = levels_[level];
+        u -= std::floor(u);
+        v -= std::floor(v);
+        int x = std::max(0, std::min((int) (u * l.width), l.width - 1));
+        int y = std::max(0, std::min((int) ((1.f - v) * l.height), l.height - 1));
+        return fetch(level, x, y);
+    }
+};
+
+#endif //__TEXTURE_H__
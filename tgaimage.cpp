@@ -1,97 +1,175 @@
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <string.h>
 #include <math.h>
+#include "framepool.h"
+#include "mappedfile.h"
+#include "renderstats.h"
+#include "resample.h"
 #include "tgaimage.h"
+#include "threadpool.h"
 
-TGAImage::TGAImage() : data(NULL), width(0), height(0), bytespp(0)
+TGAImage::TGAImage() : data(NULL), width(0), height(0), bytespp(0), framepool(NULL)
 {}
 
-TGAImage::TGAImage(int w, int h, int bpp) : data(NULL), width(w), height(h), bytespp(bpp)
+TGAImage::TGAImage(int w, int h, int bpp, FramePool *pool) : data(NULL), width(w), height(h), bytespp(bpp),
+                                                             framepool(pool)
 {
-    unsigned long nbytes = width * height * bytespp;
-    data = new unsigned char[nbytes];
+    size_t nbytes = nbytes_total();
+    data = allocate(nbytes);
     memset(data, 0, nbytes);
 }
 
-TGAImage::TGAImage(const TGAImage &img) : data(NULL), width(img.width), height(img.height), bytespp(img.bytespp)
+TGAImage::TGAImage(const TGAImage &img) : data(NULL), width(img.width), height(img.height), bytespp(img.bytespp),
+                                          framepool(img.framepool)
 {
-    unsigned long nbytes = width * height * bytespp;
-    data = new unsigned char[nbytes];
+    size_t nbytes = nbytes_total();
+    data = allocate(nbytes);
     memcpy(data, img.data, nbytes);
 }
 
+TGAImage::TGAImage(TGAImage &&img) noexcept : data(img.data), width(img.width), height(img.height),
+                                              bytespp(img.bytespp), framepool(img.framepool)
+{
+    img.data = NULL;
+    img.width = img.height = img.bytespp = 0;
+}
+
 TGAImage::~TGAImage()
 {
-    if (data) delete[] data;
+    release();
 }
 
 TGAImage &TGAImage::operator=(const TGAImage &img)
 {
     if (this != &img)
     {
-        if (data) delete[] data;
+        release();
         width = img.width;
         height = img.height;
         bytespp = img.bytespp;
-        unsigned long nbytes = width * height * bytespp;
-        data = new unsigned char[nbytes];
+        framepool = img.framepool;
+        size_t nbytes = nbytes_total();
+        data = allocate(nbytes);
         memcpy(data, img.data, nbytes);
     }
     return *this;
 }
 
-bool TGAImage::read_tga_file(const char *filename)
+TGAImage &TGAImage::operator=(TGAImage &&img) noexcept
+{
+    if (this != &img)
+    {
+        release();
+        data = img.data;
+        width = img.width;
+        height = img.height;
+        bytespp = img.bytespp;
+        framepool = img.framepool;
+        img.data = NULL;
+        img.width = img.height = img.bytespp = 0;
+    }
+    return *this;
+}
+
+size_t TGAImage::nbytes_total() const
+{
+    return (size_t) width * height * bytespp;
+}
+
+unsigned char *TGAImage::allocate(size_t nbytes)
 {
-    if (data) delete[] data;
+    return framepool ? framepool->acquire(nbytes) : allocatePixels(nbytes, false);
+}
+
+void TGAImage::release()
+{
+    if (!data) return;
+    if (framepool)
+    {
+        framepool->release(data, nbytes_total());
+    } else
+    {
+        freePixels(data, nbytes_total(), false);
+    }
     data = NULL;
-    std::ifstream in;
-    in.open(filename, std::ios::binary);
-    if (!in.is_open())
+}
+
+// Checks the header of a TGA file held in memory and finds where its pixel data starts.
+static bool parseHeader(const unsigned char *file, size_t size, TGA_Header &header, size_t &offset)
+{
+    if (size < sizeof(header))
+    {
+        std::cerr << "an error occured while reading the header\n";
+        return false;
+    }
+    memcpy((void *) &header, file, sizeof(header));
+    int bytespp = header.bitsperpixel >> 3;
+    if (header.width <= 0 || header.height <= 0 ||
+        (bytespp != TGAImage::GRAYSCALE && bytespp != TGAImage::RGB && bytespp != TGAImage::RGBA))
+    {
+        std::cerr << "bad bpp (or width/height) value\n";
+        return false;
+    }
+    // the image id and a color map, if any, sit between the header and the pixels
+    offset = sizeof(header) + (unsigned char) header.idlength;
+    if (header.colormaptype)
+    {
+        offset += (size_t) (unsigned short) header.colormaplength * (((unsigned char) header.colormapdepth + 7) >> 3);
+    }
+    if (offset > size)
+    {
+        std::cerr << "an error occured while reading the header\n";
+        return false;
+    }
+    return true;
+}
+
+bool TGAImage::read_tga_file(const char *filename)
+{
+    MappedFile file;
+    if (!file.open(filename))
     {
         std::cerr << "can't open file " << filename << "\n";
-        in.close();
         return false;
     }
+    return read_tga((const unsigned char *) file.data(), file.size());
+}
+
+bool TGAImage::read_tga(const unsigned char *file, size_t size)
+{
+    release();
+    width = height = bytespp = 0;
     TGA_Header header;
-    in.read((char *) &header, sizeof(header));
-    if (!in.good())
+    size_t offset;
+    if (!parseHeader(file, size, header, offset))
     {
-        in.close();
-        std::cerr << "an error occured while reading the header\n";
         return false;
     }
     width = header.width;
     height = header.height;
     bytespp = header.bitsperpixel >> 3;
-    if (width <= 0 || height <= 0 || (bytespp != GRAYSCALE && bytespp != RGB && bytespp != RGBA))
-    {
-        in.close();
-        std::cerr << "bad bpp (or width/height) value\n";
-        return false;
-    }
-    unsigned long nbytes = bytespp * width * height;
-    data = new unsigned char[nbytes];
+    size_t nbytes = nbytes_total();
+    data = allocate(nbytes);
     if (3 == header.datatypecode || 2 == header.datatypecode)
     {
-        in.read((char *) data, nbytes);
-        if (!in.good())
+        if (size - offset < nbytes)
         {
-            in.close();
             std::cerr << "an error occured while reading the data\n";
             return false;
         }
+        memcpy(data, file + offset, nbytes);
     } else if (10 == header.datatypecode || 11 == header.datatypecode)
     {
-        if (!load_rle_data(in))
+        if (!load_rle_data(file + offset, size - offset))
         {
-            in.close();
             std::cerr << "an error occured while reading the data\n";
             return false;
         }
     } else
     {
-        in.close();
         std::cerr << "unknown file format " << (int) header.datatypecode << "\n";
         return false;
     }
@@ -104,193 +182,488 @@ bool TGAImage::read_tga_file(const char *filename)
         flip_horizontally();
     }
     std::cerr << width << "x" << height << "/" << bytespp * 8 << "\n";
-    in.close();
     return true;
 }
 
-bool TGAImage::load_rle_data(std::ifstream &in)
+// Every chunk is checked once against both buffers, then copied or filled in bulk.
+bool TGAImage::load_rle_data(const unsigned char *in, size_t size)
 {
-    unsigned long pixelcount = width * height;
-    unsigned long currentpixel = 0;
-    unsigned long currentbyte = 0;
-    TGAColor colorbuffer;
-    do
+    const unsigned char *inEnd = in + size;
+    unsigned char *out = data;
+    unsigned char *outEnd = data + (size_t) width * height * bytespp;
+    while (out < outEnd)
     {
-        unsigned char chunkheader = 0;
-        chunkheader = in.get();
-        if (!in.good())
+        if (in == inEnd)
         {
             std::cerr << "an error occured while reading the data\n";
             return false;
         }
+        unsigned char chunkheader = *in++;
+        size_t count = (chunkheader & 127) + 1;
+        size_t nbytes = count * bytespp;
+        if (nbytes > (size_t) (outEnd - out))
+        {
+            std::cerr << "Too many pixels read\n";
+            return false;
+        }
         if (chunkheader < 128)
         {
-            chunkheader++;
-            for (int i = 0; i < chunkheader; i++)
+            if (nbytes > (size_t) (inEnd - in))
             {
-                in.read((char *) colorbuffer.bgra, bytespp);
-                if (!in.good())
-                {
-                    std::cerr << "an error occured while reading the header\n";
-                    return false;
-                }
-                for (int t = 0; t < bytespp; t++)
-                    data[currentbyte++] = colorbuffer.bgra[t];
-                currentpixel++;
-                if (currentpixel > pixelcount)
-                {
-                    std::cerr << "Too many pixels read\n";
-                    return false;
-                }
+                std::cerr << "an error occured while reading the data\n";
+                return false;
             }
+            memcpy(out, in, nbytes);
+            in += nbytes;
         } else
         {
-            chunkheader -= 127;
-            in.read((char *) colorbuffer.bgra, bytespp);
-            if (!in.good())
+            if ((size_t) bytespp > (size_t) (inEnd - in))
             {
-                std::cerr << "an error occured while reading the header\n";
+                std::cerr << "an error occured while reading the data\n";
                 return false;
             }
-            for (int i = 0; i < chunkheader; i++)
+            if (bytespp == GRAYSCALE)
+            {
+                memset(out, *in, count);
+            } else
             {
-                for (int t = 0; t < bytespp; t++)
-                    data[currentbyte++] = colorbuffer.bgra[t];
-                currentpixel++;
-                if (currentpixel > pixelcount)
+                // one pixel, then keep doubling the filled part
+                memcpy(out, in, bytespp);
+                for (size_t filled = bytespp; filled < nbytes; filled *= 2)
                 {
-                    std::cerr << "Too many pixels read\n";
-                    return false;
+                    memcpy(out + filled, out, std::min(filled, nbytes - filled));
                 }
             }
+            in += bytespp;
         }
-    } while (currentpixel < pixelcount);
+        out += nbytes;
+    }
+    return true;
+}
+
+TGAView::TGAView() : file_(), image_(), data_(NULL), width_(0), height_(0), bytespp_(0), mapped_(false)
+{}
+
+bool TGAView::read_tga_file(const char *filename)
+{
+    data_ = NULL;
+    width_ = height_ = bytespp_ = 0;
+    mapped_ = false;
+    if (!file_.open(filename))
+    {
+        std::cerr << "can't open file " << filename << "\n";
+        return false;
+    }
+    const unsigned char *file = (const unsigned char *) file_.data();
+    TGA_Header header;
+    size_t offset;
+    if (!parseHeader(file, file_.size(), header, offset))
+    {
+        file_.close();
+        return false;
+    }
+    size_t nbytes = (size_t) (header.bitsperpixel >> 3) * header.width * header.height;
+    bool raw = 3 == header.datatypecode || 2 == header.datatypecode;
+    if (raw && (header.imagedescriptor & 0x30) == 0x20 && file_.size() - offset >= nbytes)
+    {
+        data_ = file + offset;
+        width_ = header.width;
+        height_ = header.height;
+        bytespp_ = header.bitsperpixel >> 3;
+        mapped_ = true;
+        return true;
+    }
+    bool ok = image_.read_tga(file, file_.size());
+    file_.close();
+    if (!ok)
+    {
+        return false;
+    }
+    data_ = image_.buffer();
+    width_ = image_.get_width();
+    height_ = image_.get_height();
+    bytespp_ = image_.get_bytespp();
     return true;
 }
 
-bool TGAImage::write_tga_file(const char *filename, bool rle)
+TGAColor TGAView::get(int x, int y) const
+{
+    if (!data_ || x < 0 || y < 0 || x >= width_ || y >= height_)
+    {
+        return TGAColor();
+    }
+    return TGAColor(data_ + ((size_t) y * width_ + x) * bytespp_, bytespp_);
+}
+
+int TGAView::get_width() const
+{
+    return width_;
+}
+
+int TGAView::get_height() const
+{
+    return height_;
+}
+
+int TGAView::get_bytespp() const
+{
+    return bytespp_;
+}
+
+const unsigned char *TGAView::buffer() const
 {
+    return data_;
+}
+
+bool TGAView::is_mapped() const
+{
+    return mapped_;
+}
+
+bool TGAImage::write_tga_file(const char *filename, bool rle, ThreadPool *pool)
+{
+    return ::write_tga_file(view(), filename, rle, pool);
+}
+
+bool TGAImage::encode_tga(std::vector<unsigned char> &out, bool rle, ThreadPool *pool)
+{
+    return ::encode_tga(view(), out, rle, pool);
+}
+
+ImageView TGAImage::view()
+{
+    return ImageView(data, width, height, bytespp);
+}
+
+template<int BPP>
+static inline bool samePixel(const unsigned char *a, const unsigned char *b)
+{
+    return !memcmp(a, b, BPP);
+}
+
+// End of the run of pixels equal to pixel p. Inside a run the bytes repeat with period BPP,
+// so it is extended 16 bytes at a time by comparing the data with itself shifted by a pixel.
+template<int BPP>
+static long runEnd(const unsigned char *data, long p, long npixels)
+{
+    const long step = 16 / BPP;
+    long q = p + 1;
+    unsigned long long a[2];
+    unsigned long long b[2];
+    while (q * BPP + 16 <= npixels * BPP)
+    {
+        memcpy(a, data + (q - 1) * BPP, 16);
+        memcpy(b, data + q * BPP, 16);
+        if (a[0] != b[0] || a[1] != b[1])
+        {
+            break;
+        }
+        q += step;
+    }
+    while (q < npixels && samePixel<BPP>(data + (q - 1) * BPP, data + q * BPP))
+    {
+        q++;
+    }
+    return q;
+}
+
+// First pixel p in [begin, end), or -1, that starts a run of equal pixels right after a
+// different one. Whatever came before, a greedy encoder that ends raw chunks in front of every
+// equal pair and run chunks at the first differing pixel starts a chunk at p, so encoding the
+// stretches between such pixels on their own never costs more than the previous
+// one-chunk-at-a-time encoder did.
+template<int BPP>
+static long runBoundary(const unsigned char *data, long npixels, long begin, long end)
+{
+    for (long p = std::max(begin, 1L); p < end && p + 1 < npixels; p++)
+    {
+        const unsigned char *q = data + p * BPP;
+        if (!samePixel<BPP>(q - BPP, q) && samePixel<BPP>(q, q + BPP))
+        {
+            return p;
+        }
+    }
+    return -1;
+}
+
+// Smallest chunk sequence for npixels pixels. cost[i] is the size of the best encoding of the
+// first i pixels and never decreases with i. Once a chunk ending at i can cover two pixels of
+// a run, the run chunk starting as far back as allowed is the best choice; otherwise the best
+// raw chunk comes from a sliding minimum of cost[j] - j * BPP over the last 128 positions.
+template<int BPP>
+static void encodeRle(const unsigned char *data, long npixels, std::vector<unsigned char> &out)
+{
+    const int max_chunk_length = 128;
+    std::vector<unsigned int> costs(npixels + 1);
+    std::vector<unsigned char> chunks(npixels + 1);
+    unsigned int *cost = costs.data();
+    unsigned char *chunk = chunks.data(); // length - 1, high bit set for run chunks
+    long window[512];                     // raw chunk starts with increasing keys, at most the
+                                          // last 128 positions and those of one run
+    long long keys[512];
+    int head = 0;
+    int tail = 0;
+    cost[0] = 0;
+    window[0] = 0;
+    keys[tail++] = 0;
+    for (long p = 0; p < npixels;)
+    {
+        long q = runEnd<BPP>(data, p, npixels);
+        for (long i = p + 1; i <= q; i++)
+        {
+            if (i >= p + 2)
+            {
+                long r = std::max(p, i - max_chunk_length);
+                cost[i] = cost[r] + 1 + BPP;
+                chunk[i] = (unsigned char) (0x80 | (i - r - 1));
+            } else
+            {
+                while (window[head & 511] < i - max_chunk_length)
+                {
+                    head++;
+                }
+                long j = window[head & 511];
+                cost[i] = cost[j] + 1 + (unsigned int) (i - j) * BPP;
+                chunk[i] = (unsigned char) (i - j - 1);
+            }
+            // raw chunks ending past the run never start more than 128 pixels before its end
+            if (i + max_chunk_length >= q)
+            {
+                long long key = (long long) cost[i] - i * BPP;
+                while (tail != head && keys[(tail - 1) & 511] >= key)
+                {
+                    tail--;
+                }
+                window[tail & 511] = i;
+                keys[tail++ & 511] = key;
+            }
+        }
+        p = q;
+    }
+
+    // chunks are picked back to front, so the output is filled from its end
+    size_t base = out.size();
+    out.resize(base + cost[npixels]);
+    unsigned char *dst = out.data() + out.size();
+    for (long i = npixels; i > 0;)
+    {
+        int length = (chunk[i] & 0x7f) + 1;
+        bool run = (chunk[i] & 0x80) != 0;
+        i -= length;
+        if (run)
+        {
+            dst -= BPP;
+            memcpy(dst, data + i * BPP, BPP);
+            *--dst = (unsigned char) (length + 127);
+        } else
+        {
+            dst -= length * BPP;
+            memcpy(dst, data + i * BPP, length * BPP);
+            *--dst = (unsigned char) (length - 1);
+        }
+    }
+}
+
+template<int BPP>
+static void encodeBands(const unsigned char *data, int width, int height, std::vector<unsigned char> &out,
+                        ThreadPool *pool)
+{
+    long npixels = (long) width * height;
+    int rows = std::max(1, RLE_BAND_PIXELS / std::max(width, 1));
+    int nbands = (height + rows - 1) / rows;
+    std::vector<long> starts(nbands);
+    std::vector<std::vector<unsigned char> > bands(nbands);
+    auto findStart = [&](int band) {
+        long begin = (long) band * rows * width;
+        long end = std::min(npixels, begin + (long) rows * width);
+        starts[band] = band ? runBoundary<BPP>(data, npixels, begin, end) : 0;
+    };
+    // a band without a chunk boundary is encoded by the band before it
+    auto encodeBand = [&](int band) {
+        if (starts[band] < 0)
+        {
+            return;
+        }
+        long end = npixels;
+        for (int next = band + 1; next < nbands && end == npixels; next++)
+        {
+            if (starts[next] >= 0)
+            {
+                end = starts[next];
+            }
+        }
+        encodeRle<BPP>(data + starts[band] * BPP, end - starts[band], bands[band]);
+    };
+    if (pool && nbands > 1)
+    {
+        pool->parallelFor(nbands, findStart);
+        pool->parallelFor(nbands, encodeBand);
+    } else
+    {
+        for (int band = 0; band < nbands; band++)
+        {
+            findStart(band);
+        }
+        for (int band = 0; band < nbands; band++)
+        {
+            encodeBand(band);
+        }
+    }
+    size_t total = out.size();
+    for (int band = 0; band < nbands; band++)
+    {
+        total += bands[band].size();
+    }
+    out.reserve(total);
+    for (int band = 0; band < nbands; band++)
+    {
+        out.insert(out.end(), bands[band].begin(), bands[band].end());
+    }
+}
+
+bool encode_tga(const ImageView &view, std::vector<unsigned char> &out, bool rle, ThreadPool *pool)
+{
+    StageTimer timer(STAGE_ENCODE);
     unsigned char developer_area_ref[4] = {0, 0, 0, 0};
     unsigned char extension_area_ref[4] = {0, 0, 0, 0};
     unsigned char footer[18] = {'T', 'R', 'U', 'E', 'V', 'I', 'S', 'I', 'O', 'N', '-', 'X', 'F', 'I', 'L', 'E', '.',
                                 '\0'};
-    std::ofstream out;
-    out.open(filename, std::ios::binary);
-    if (!out.is_open())
+    if (!view.origin)
     {
-        std::cerr << "can't open file " << filename << "\n";
-        out.close();
+        std::cerr << "can't dump the tga file\n";
         return false;
     }
+    bool topDown = view.rowStride >= 0;
+    bool leftToRight = view.pixelStride >= 0;
     TGA_Header header;
     memset((void *) &header, 0, sizeof(header));
-    header.bitsperpixel = bytespp << 3;
-    header.width = width;
-    header.height = height;
-    header.datatypecode = (bytespp == GRAYSCALE ? (rle ? 11 : 3) : (rle ? 10 : 2));
-    header.imagedescriptor = 0x20; // top-left origin
-    out.write((char *) &header, sizeof(header));
-    if (!out.good())
+    header.bitsperpixel = view.bytespp << 3;
+    header.width = view.width;
+    header.height = view.height;
+    header.datatypecode = (view.bytespp == TGAImage::GRAYSCALE ? (rle ? 11 : 3) : (rle ? 10 : 2));
+    header.imagedescriptor = (topDown ? 0x20 : 0) | (leftToRight ? 0 : 0x10);
+    // the file starts with the pixel at the lowest address
+    const unsigned char *pixels = view.pixel(leftToRight ? 0 : view.width - 1, topDown ? 0 : view.height - 1);
+    size_t bytesPerLine = (size_t) view.width * view.bytespp;
+    std::vector<unsigned char> packed;
+    if (view.height > 1 && (size_t) std::abs(view.rowStride) != bytesPerLine)
     {
-        out.close();
-        std::cerr << "can't dump the tga file\n";
-        return false;
+        packed.resize(bytesPerLine * view.height);
+        for (int j = 0; j < view.height; j++)
+        {
+            memcpy(packed.data() + j * bytesPerLine, pixels + j * std::abs(view.rowStride), bytesPerLine);
+        }
+        pixels = packed.data();
     }
+    out.clear();
+    out.insert(out.end(), (unsigned char *) &header, (unsigned char *) &header + sizeof(header));
     if (!rle)
     {
-        out.write((char *) data, width * height * bytespp);
-        if (!out.good())
-        {
-            std::cerr << "can't unload raw data\n";
-            out.close();
-            return false;
-        }
+        out.insert(out.end(), pixels, pixels + bytesPerLine * view.height);
     } else
     {
-        if (!unload_rle_data(out))
+        // the smallest chunk sequence for the bands, which is never larger than what breaking
+        // raw chunks at every pair of equal pixels gives
+        switch (view.bytespp)
         {
-            out.close();
-            std::cerr << "can't unload rle data\n";
-            return false;
+            case TGAImage::GRAYSCALE:
+                encodeBands<1>(pixels, view.width, view.height, out, pool);
+                break;
+            case TGAImage::RGB:
+                encodeBands<3>(pixels, view.width, view.height, out, pool);
+                break;
+            default:
+                encodeBands<4>(pixels, view.width, view.height, out, pool);
+                break;
         }
     }
-    out.write((char *) developer_area_ref, sizeof(developer_area_ref));
-    if (!out.good())
+    out.insert(out.end(), developer_area_ref, developer_area_ref + sizeof(developer_area_ref));
+    out.insert(out.end(), extension_area_ref, extension_area_ref + sizeof(extension_area_ref));
+    out.insert(out.end(), footer, footer + sizeof(footer));
+    return true;
+}
+
+bool write_tga_file(const ImageView &view, const char *filename, bool rle, ThreadPool *pool)
+{
+    std::vector<unsigned char> bytes;
+    if (!encode_tga(view, bytes, rle, pool))
     {
-        std::cerr << "can't dump the tga file\n";
-        out.close();
         return false;
     }
-    out.write((char *) extension_area_ref, sizeof(extension_area_ref));
-    if (!out.good())
+    StageTimer timer(STAGE_WRITE);
+    std::ofstream out;
+    out.open(filename, std::ios::binary);
+    if (!out.is_open())
     {
-        std::cerr << "can't dump the tga file\n";
+        std::cerr << "can't open file " << filename << "\n";
         out.close();
         return false;
     }
-    out.write((char *) footer, sizeof(footer));
+    out.write((char *) bytes.data(), bytes.size());
+    out.close();
     if (!out.good())
     {
         std::cerr << "can't dump the tga file\n";
-        out.close();
         return false;
     }
-    out.close();
+    countStat(BYTES_WRITTEN, (long long) bytes.size());
     return true;
 }
 
-// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
-bool TGAImage::unload_rle_data(std::ofstream &out)
+TGAColor ImageView::get(int x, int y) const
 {
-    const unsigned char max_chunk_length = 128;
-    unsigned long npixels = width * height;
-    unsigned long curpix = 0;
-    while (curpix < npixels)
+    if (!origin || x < 0 || y < 0 || x >= width || y >= height)
     {
-        unsigned long chunkstart = curpix * bytespp;
-        unsigned long curbyte = curpix * bytespp;
-        unsigned char run_length = 1;
-        bool raw = true;
-        while (curpix + run_length < npixels && run_length < max_chunk_length)
-        {
-            bool succ_eq = true;
-            for (int t = 0; succ_eq && t < bytespp; t++)
-            {
-                succ_eq = (data[curbyte + t] == data[curbyte + t + bytespp]);
-            }
-            curbyte += bytespp;
-            if (1 == run_length)
-            {
-                raw = !succ_eq;
-            }
-            if (raw && succ_eq)
-            {
-                run_length--;
-                break;
-            }
-            if (!raw && !succ_eq)
-            {
-                break;
-            }
-            run_length++;
-        }
-        curpix += run_length;
-        out.put(raw ? run_length - 1 : run_length + 127);
-        if (!out.good())
-        {
-            std::cerr << "can't dump the tga file\n";
-            return false;
-        }
-        out.write((char *) (data + chunkstart), (raw ? run_length * bytespp : bytespp));
-        if (!out.good())
-        {
-            std::cerr << "can't dump the tga file\n";
-            return false;
-        }
+        return TGAColor();
+    }
+    return TGAColor(pixel(x, y), bytespp);
+}
+
+bool ImageView::set(int x, int y, const TGAColor &c) const
+{
+    if (!origin || x < 0 || y < 0 || x >= width || y >= height)
+    {
+        return false;
     }
+    memcpy(pixel(x, y), c.bgra, bytespp);
     return true;
 }
 
+ImageView ImageView::flipped_vertically() const
+{
+    ImageView flipped = *this;
+    if (height > 0)
+    {
+        flipped.origin = pixel(0, height - 1);
+    }
+    flipped.rowStride = -rowStride;
+    return flipped;
+}
+
+ImageView ImageView::flipped_horizontally() const
+{
+    ImageView flipped = *this;
+    if (width > 0)
+    {
+        flipped.origin = pixel(width - 1, 0);
+    }
+    flipped.pixelStride = -pixelStride;
+    return flipped;
+}
+
+ImageView ImageView::cropped(int x, int y, int w, int h) const
+{
+    int x0 = std::max(x, 0);
+    int y0 = std::max(y, 0);
+    int x1 = std::min(x + w, width);
+    int y1 = std::min(y + h, height);
+    ImageView crop = *this;
+    crop.width = std::max(x1 - x0, 0);
+    crop.height = std::max(y1 - y0, 0);
+    crop.origin = crop.width && crop.height ? pixel(x0, y0) : NULL;
+    return crop;
+}
+
 TGAColor TGAImage::get(int x, int y)
 {
     if (!data || x < 0 || y < 0 || x >= width || y >= height)
@@ -338,15 +711,15 @@ int TGAImage::get_height()
 bool TGAImage::flip_horizontally()
 {
     if (!data) return false;
-    int half = width >> 1;
-    for (int i = 0; i < half; i++)
+    StageTimer timer(STAGE_FLIP);
+    size_t bytes_per_line = (size_t) width * bytespp;
+    for (int j = 0; j < height; j++)
     {
-        for (int j = 0; j < height; j++)
+        unsigned char *left = data + j * bytes_per_line;
+        unsigned char *right = left + bytes_per_line - bytespp;
+        for (; left < right; left += bytespp, right -= bytespp)
         {
-            TGAColor c1 = get(i, j);
-            TGAColor c2 = get(width - 1 - i, j);
-            set(i, j, c2);
-            set(width - 1 - i, j, c1);
+            std::swap_ranges(left, left + bytespp, right);
         }
     }
     return true;
@@ -355,18 +728,15 @@ bool TGAImage::flip_horizontally()
 bool TGAImage::flip_vertically()
 {
     if (!data) return false;
-    unsigned long bytes_per_line = width * bytespp;
-    unsigned char *line = new unsigned char[bytes_per_line];
+    StageTimer timer(STAGE_FLIP);
+    size_t bytes_per_line = (size_t) width * bytespp;
     int half = height >> 1;
     for (int j = 0; j < half; j++)
     {
-        unsigned long l1 = j * bytes_per_line;
-        unsigned long l2 = (height - 1 - j) * bytes_per_line;
-        memmove((void *) line, (void *) (data + l1), bytes_per_line);
-        memmove((void *) (data + l1), (void *) (data + l2), bytes_per_line);
-        memmove((void *) (data + l2), (void *) line, bytes_per_line);
+        unsigned char *l1 = data + j * bytes_per_line;
+        unsigned char *l2 = data + (height - 1 - j) * bytes_per_line;
+        std::swap_ranges(l1, l1 + bytes_per_line, l2);
     }
-    delete[] line;
     return true;
 }
 
@@ -380,42 +750,12 @@ void TGAImage::clear()
     memset((void *) data, 0, width * height * bytespp);
 }
 
-bool TGAImage::scale(int w, int h)
+bool TGAImage::scale(int w, int h, ResampleFilter filter, ThreadPool *pool)
 {
     if (w <= 0 || h <= 0 || !data) return false;
-    unsigned char *tdata = new unsigned char[w * h * bytespp];
-    int nscanline = 0;
-    int oscanline = 0;
-    int erry = 0;
-    unsigned long nlinebytes = w * bytespp;
-    unsigned long olinebytes = width * bytespp;
-    for (int j = 0; j < height; j++)
-    {
-        int errx = width - w;
-        int nx = -bytespp;
-        int ox = -bytespp;
-        for (int i = 0; i < width; i++)
-        {
-            ox += bytespp;
-            errx += w;
-            while (errx >= (int) width)
-            {
-                errx -= width;
-                nx += bytespp;
-                memcpy(tdata + nscanline + nx, data + oscanline + ox, bytespp);
-            }
-        }
-        erry += h;
-        oscanline += olinebytes;
-        while (erry >= (int) height)
-        {
-            if (erry >= (int) height << 1) // it means we jump over a scanline
-                memcpy(tdata + nscanline + nlinebytes, tdata + nscanline, nlinebytes);
-            erry -= height;
-            nscanline += nlinebytes;
-        }
-    }
-    delete[] data;
+    unsigned char *tdata = allocate((size_t) w * h * bytespp);
+    resample(view(), ImageView(tdata, w, h, bytespp), filter, pool);
+    release();
     data = tdata;
     width = w;
     height = h;
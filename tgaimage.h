@@ -1,7 +1,25 @@
 #ifndef __IMAGE_H__
 #define __IMAGE_H__
 
+#include <cstddef>
 #include <fstream>
+#include <vector>
+#include "mappedfile.h"
+
+class FramePool;
+
+class ThreadPool;
+
+// RLE data is encoded in bands of about this many pixels, whole scanlines each
+const int RLE_BAND_PIXELS = 65536;
+
+// filters of resample() in resample.h
+enum ResampleFilter
+{
+    FILTER_BOX,      // average of the covered pixels
+    FILTER_BILINEAR, // tent, widened into a triangle filter when shrinking
+    FILTER_LANCZOS   // windowed sinc over three lobes, the sharpest
+};
 
 #pragma pack(push, 1)
 struct TGA_Header
@@ -70,6 +88,52 @@ struct TGAColor
     }
 };
 
+// Window onto pixels owned by an image: pixel (x, y) sits at origin + y * rowStride +
+// x * pixelStride, where pixelStride is bytespp or -bytespp. Flipping a view negates a stride
+// and cropping it moves the origin, so neither touches the pixels. A view must not outlive the
+// pixels it shows.
+struct ImageView
+{
+    unsigned char *origin;
+    int width;
+    int height;
+    int bytespp;
+    long rowStride;
+    long pixelStride;
+
+    ImageView() : origin(NULL), width(0), height(0), bytespp(0), rowStride(0), pixelStride(0)
+    {}
+
+    // rows packed one after the other, in order
+    ImageView(unsigned char *data, int w, int h, int bpp) : origin(data), width(w), height(h), bytespp(bpp),
+                                                            rowStride((long) w * bpp), pixelStride(bpp)
+    {}
+
+    inline unsigned char *pixel(int x, int y) const
+    { return origin + y * rowStride + x * pixelStride; }
+
+    TGAColor get(int x, int y) const;
+
+    bool set(int x, int y, const TGAColor &c) const;
+
+    ImageView flipped_vertically() const;
+
+    ImageView flipped_horizontally() const;
+
+    // the part of the view inside the rectangle, clipped to the view
+    ImageView cropped(int x, int y, int w, int h) const;
+};
+
+// Encodes the pixels a view shows as a TGA file. Rows and pixels are stored in memory order and
+// the origin bits of the image descriptor tell readers which corner comes first, so a flipped
+// view costs nothing; views over whole rows are encoded in place, narrower crops are gathered
+// into packed rows first. RLE bands are encoded in parallel on the pool if there is one.
+bool encode_tga(const ImageView &view, std::vector<unsigned char> &out, bool rle = true,
+                ThreadPool *pool = nullptr);
+
+// encodes the whole file in memory and writes it in one go
+bool write_tga_file(const ImageView &view, const char *filename, bool rle = true, ThreadPool *pool = nullptr);
+
 class TGAImage
 {
 protected:
@@ -77,10 +141,17 @@ protected:
     int width;
     int height;
     int bytespp;
+    FramePool *framepool; // the buffer is borrowed from it, or owned if there is none
 
-    bool load_rle_data(std::ifstream &in);
+    size_t nbytes_total() const;
 
-    bool unload_rle_data(std::ofstream &out);
+    unsigned char *allocate(size_t nbytes);
+
+    // gives the buffer back to its pool or frees it
+    void release();
+
+    // size is what is left of the file after the header
+    bool load_rle_data(const unsigned char *in, size_t size);
 
 public:
     enum Format
@@ -90,19 +161,36 @@ public:
 
     TGAImage();
 
-    TGAImage(int w, int h, int bpp);
+    // Pixels are PIXEL_ALIGNMENT aligned. With a pool the buffer is borrowed from it and handed
+    // back when the image goes away.
+    TGAImage(int w, int h, int bpp, FramePool *pool = NULL);
 
     TGAImage(const TGAImage &img);
 
+    // leaves img empty
+    TGAImage(TGAImage &&img) noexcept;
+
+    // The file is memory-mapped and decoded straight from the mapping.
     bool read_tga_file(const char *filename);
 
-    bool write_tga_file(const char *filename, bool rle = true);
+    // decodes a whole TGA file held in memory
+    bool read_tga(const unsigned char *file, size_t size);
+
+    // the whole image, row 0 first
+    bool write_tga_file(const char *filename, bool rle = true, ThreadPool *pool = nullptr);
+
+    bool encode_tga(std::vector<unsigned char> &out, bool rle = true, ThreadPool *pool = nullptr);
+
+    // all pixels, row 0 first; a flipped view of it is usually cheaper than the flips below,
+    // which move every pixel
+    ImageView view();
 
     bool flip_horizontally();
 
     bool flip_vertically();
 
-    bool scale(int w, int h);
+    // resamples the image to w x h, see resample()
+    bool scale(int w, int h, ResampleFilter filter = FILTER_BILINEAR, ThreadPool *pool = nullptr);
 
     TGAColor get(int x, int y);
 
@@ -114,6 +202,8 @@ public:
 
     TGAImage &operator=(const TGAImage &img);
 
+    TGAImage &operator=(TGAImage &&img) noexcept;
+
     int get_width();
 
     int get_height();
@@ -125,4 +215,41 @@ public:
     void clear();
 };
 
+// Read-only image loaded from a TGA file. Uncompressed files stored top to bottom and left to
+// right are used in place, straight from the memory-mapped file with no copy; any other file is
+// decoded into an image the view owns.
+class TGAView
+{
+private:
+    MappedFile file_;
+    TGAImage image_;
+    const unsigned char *data_;
+    int width_;
+    int height_;
+    int bytespp_;
+    bool mapped_;
+
+    TGAView(const TGAView &);
+
+    TGAView &operator=(const TGAView &);
+
+public:
+    TGAView();
+
+    bool read_tga_file(const char *filename);
+
+    TGAColor get(int x, int y) const;
+
+    int get_width() const;
+
+    int get_height() const;
+
+    int get_bytespp() const;
+
+    const unsigned char *buffer() const;
+
+    // whether the pixels are read from the file mapping itself
+    bool is_mapped() const;
+};
+
 #endif //__IMAGE_H__
@@ -0,0 +1,131 @@
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(int nthreads) : threads_(), queues_(), mutex_(), wake_(), done_(), task_(nullptr),
+                                       pending_(0), generation_(0), stop_(false)
+{
+    if (nthreads <= 0)
+    {
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < nthreads; i++)
+    {
+        queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    for (int i = 1; i < nthreads; i++)
+    {
+        threads_.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+        threads_[i].join();
+    }
+}
+
+int ThreadPool::size() const
+{
+    return (int) queues_.size();
+}
+
+bool ThreadPool::pop(int worker, int &item)
+{
+    int n = size();
+    for (int i = 0; i < n; i++)
+    {
+        Queue &queue = *queues_[(worker + i) % n];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.items.empty())
+        {
+            continue;
+        }
+        // own work is taken from the back, stolen work from the front
+        if (i == 0)
+        {
+            item = queue.items.back();
+            queue.items.pop_back();
+        } else
+        {
+            item = queue.items.front();
+            queue.items.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::drain(int worker)
+{
+    int item;
+    while (pop(worker, item))
+    {
+        (*task_)(item);
+        if (pending_.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.notify_all();
+        }
+    }
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+    unsigned long seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_)
+            {
+                return;
+            }
+            seen = generation_;
+        }
+        drain(worker);
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)> &task)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+    int n = size();
+    if (n == 1)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+    task_ = &task;
+    pending_ = count;
+    for (int w = 0; w < n; w++)
+    {
+        Queue &queue = *queues_[w];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        // queues are popped from the back, so push the range reversed to run it in order
+        for (int i = (int) ((long long) (w + 1) * count / n) - 1; i >= (int) ((long long) w * count / n); i--)
+        {
+            queue.items.push_back(i);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation_++;
+    }
+    wake_.notify_all();
+    drain(0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return pending_ == 0; });
+}
@@ -0,0 +1,53 @@
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads with one task queue each. parallelFor() deals the task
+// indices out in contiguous ranges; a worker that runs dry steals from the front of the
+// other queues. The calling thread works as well, so a pool of size 1 spawns no threads.
+// parallelFor() must not be called from inside a task.
+class ThreadPool
+{
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<int> items;
+    };
+
+    std::vector<std::thread> threads_;
+    std::vector<std::unique_ptr<Queue> > queues_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(int)> *task_;
+    std::atomic<int> pending_;
+    unsigned long generation_;
+    bool stop_;
+
+    bool pop(int worker, int &item);
+
+    void drain(int worker);
+
+    void workerLoop(int worker);
+
+public:
+    // nthreads <= 0 uses one thread per hardware core
+    explicit ThreadPool(int nthreads = 0);
+
+    ~ThreadPool();
+
+    int size() const;
+
+    void parallelFor(int count, const std::function<void(int)> &task);
+};
+
+#endif //__THREADPOOL_H__
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include "transform.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// vertices per parallel batch
+const int TRANSFORM_BATCH = 16384;
+
+static void transformScalar(const Vec3f *verts, int begin, int end, const Mat4f &m, float *xs, float *ys, float *zs,
+                            float *ws)
+{
+    for (int i = begin; i < end; i++)
+    {
+        Vec4f clip = m * Vec4f(verts[i], 1.f);
+        Vec3f p = clip.project();
+        xs[i] = p.x;
+        ys[i] = p.y;
+        zs[i] = p.z;
+        ws[i] = 1.f / clip.w;
+    }
+}
+
+#ifdef __SSE2__
+static void transformSse2(const Vec3f *verts, int begin, int end, const Mat4f &m, float *xs, float *ys, float *zs,
+                          float *ws)
+{
+    __m128 c[4][4];
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            c[i][j] = _mm_set1_ps(m[i][j]);
+        }
+    }
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        // 4 packed xyz triples -> one register per coordinate
+        const float *p = &verts[i].x;
+        __m128 a = _mm_loadu_ps(p);     // x0 y0 z0 x1
+        __m128 b = _mm_loadu_ps(p + 4); // y1 z1 x2 y2
+        __m128 d = _mm_loadu_ps(p + 8); // z2 x3 y3 z3
+        __m128 vx = _mm_shuffle_ps(a, _mm_shuffle_ps(b, d, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+        __m128 vy = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                                   _mm_shuffle_ps(b, d, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 vz = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), d, _MM_SHUFFLE(3, 0, 2, 0));
+        __m128 r[4];
+        for (int k = 0; k < 4; k++)
+        {
+            __m128 sum = _mm_add_ps(_mm_mul_ps(c[k][0], vx), _mm_mul_ps(c[k][1], vy));
+            r[k] = _mm_add_ps(_mm_add_ps(sum, _mm_mul_ps(c[k][2], vz)), c[k][3]);
+        }
+        // divide rather than multiply by 1 / w so the tail and the SIMD lanes round alike
+        _mm_storeu_ps(xs + i, _mm_div_ps(r[0], r[3]));
+        _mm_storeu_ps(ys + i, _mm_div_ps(r[1], r[3]));
+        _mm_storeu_ps(zs + i, _mm_div_ps(r[2], r[3]));
+        _mm_storeu_ps(ws + i, _mm_div_ps(_mm_set1_ps(1.f), r[3]));
+    }
+    transformScalar(verts, i, end, m, xs, ys, zs, ws);
+}
+#endif
+
+static void transformRange(const Vec3f *verts, int begin, int end, const Mat4f &m, VertexBuffer &out)
+{
+#ifdef __SSE2__
+    transformSse2(verts, begin, end, m, out.x.data(), out.y.data(), out.z.data(), out.invw.data());
+#else
+    transformScalar(verts, begin, end, m, out.x.data(), out.y.data(), out.z.data(), out.invw.data());
+#endif
+}
+
+void transformVertices(const Vec3f *verts, int n, const Mat4f &mvp, VertexBuffer &out, ThreadPool *pool)
+{
+    out.x.resize(n);
+    out.y.resize(n);
+    out.z.resize(n);
+    out.invw.resize(n);
+    int nbatches = (n + TRANSFORM_BATCH - 1) / TRANSFORM_BATCH;
+    if (pool && nbatches > 1)
+    {
+        pool->parallelFor(nbatches, [&](int batch) {
+            transformRange(verts, batch * TRANSFORM_BATCH, std::min(n, (batch + 1) * TRANSFORM_BATCH), mvp, out);
+        });
+    } else
+    {
+        transformRange(verts, 0, n, mvp, out);
+    }
+}
+
+void faceLighting(const Vec3f *verts, const int *corners, int n, const Vec3f &light, float *intensity)
+{
+    Vec3Pack l(light);
+    int i = 0;
+    for (; i + FloatPack::LANES <= n; i += FloatPack::LANES)
+    {
+        const int *c = corners + 3 * i;
+        Vec3Pack v0 = Vec3Pack::gather(verts, c, 3);
+        Vec3Pack v1 = Vec3Pack::gather(verts, c + 1, 3);
+        Vec3Pack v2 = Vec3Pack::gather(verts, c + 2, 3);
+        (cross(v2 - v0, v1 - v0).normalized() * l).store(intensity + i);
+    }
+    for (; i < n; i++)
+    {
+        const int *c = corners + 3 * i;
+        Vec3f normal = cross(verts[c[2]] - verts[c[0]], verts[c[1]] - verts[c[0]]);
+        intensity[i] = normal.normalize() * light;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef __TRANSFORM_H__
+#define __TRANSFORM_H__
+
+#include <vector>
+#include "geometry.h"
+#include "threadpool.h"
+
+// Screen-space position of every model vertex, one array per coordinate: x and y in pixels,
+// z the depth in [0, 1] handed to the rasterizer, invw the reciprocal of the clip-space w that
+// perspective-correct interpolation weighs attributes with.
+struct VertexBuffer
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> invw;
+
+    inline Vec3f get(int i) const
+    { return Vec3f(x[i], y[i], z[i]); }
+};
+
+// Projects n vertices through mvp (model-view-projection followed by the viewport) with the
+// perspective divide, four at a time with SSE2 where available. With a pool the vertices are
+// split into batches that run in parallel.
+void transformVertices(const Vec3f *verts, int n, const Mat4f &mvp, VertexBuffer &out, ThreadPool *pool = nullptr);
+
+// Diffuse term of n triangles given by three vertex indices each: the unit normal of
+// (v2 - v0) x (v1 - v0) dotted with light, FloatPack::LANES triangles at a time.
+void faceLighting(const Vec3f *verts, const int *corners, int n, const Vec3f &light, float *intensity);
+
+#endif //__TRANSFORM_H__
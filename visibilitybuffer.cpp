@@ -0,0 +1,33 @@
+#include <algorithm>
+#include "visibilitybuffer.h"
+
+VisibilityBuffer::VisibilityBuffer(int w, int h) : width_(w), height_(h), samples_((size_t) w * h)
+{
+    clear();
+}
+
+int VisibilityBuffer::get_width() const
+{
+    return width_;
+}
+
+int VisibilityBuffer::get_height() const
+{
+    return height_;
+}
+
+VisibilitySample *VisibilityBuffer::samples()
+{
+    return samples_.data();
+}
+
+const VisibilitySample *VisibilityBuffer::samples() const
+{
+    return samples_.data();
+}
+
+void VisibilityBuffer::clear()
+{
+    VisibilitySample empty = {-1, 0.f, 0.f};
+    std::fill(samples_.begin(), samples_.end(), empty);
+}
@@ -0,0 +1,40 @@
+#ifndef __VISIBILITYBUFFER_H__
+#define __VISIBILITYBUFFER_H__
+
+#include <vector>
+
+// What is visible at a pixel: the index of a triangle, -1 where none was drawn, and the
+// barycentric weights of vertices 1 and 2 of its setup at the pixel center; vertex 0 has the
+// rest. The weights are screen-space, shading makes them perspective-correct.
+struct VisibilitySample
+{
+    int id;
+    float b1;
+    float b2;
+};
+
+// One VisibilitySample per pixel, entry y * width + x for pixel (x, y), so a frame can be shaded
+// again under other lights without rasterizing it again. Clearing sets every id to -1. Callers
+// touching disjoint pixels may use the buffer from different threads.
+class VisibilityBuffer
+{
+private:
+    int width_;
+    int height_;
+    std::vector<VisibilitySample> samples_;
+
+public:
+    VisibilityBuffer(int w, int h);
+
+    int get_width() const;
+
+    int get_height() const;
+
+    VisibilitySample *samples();
+
+    const VisibilitySample *samples() const;
+
+    void clear();
+};
+
+#endif //__VISIBILITYBUFFER_H__
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "renderstats.h"
+#include "wireframe.h"
+
+// screen positions further out than this are dropped rather than converted to int
+const float WIREFRAME_COORD_LIMIT = 1 << 24;
+
+void buildEdgeList(const Model &model, std::vector<Edge> &edges)
+{
+    std::vector<unsigned long long> keys;
+    keys.reserve(model.nindices());
+    for (int i = 0; i < model.nfaces(); i++)
+    {
+        Span<int> face = model.face(i);
+        for (int j = 0; j < face.size; j++)
+        {
+            unsigned int v0 = face[j];
+            unsigned int v1 = face[(j + 1) % face.size];
+            if (v0 > v1)
+            {
+                std::swap(v0, v1);
+            }
+            keys.push_back((unsigned long long) v0 << 32 | v1);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    edges.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        edges[i].v0 = (int) (keys[i] >> 32);
+        edges[i].v1 = (int) (keys[i] & 0xffffffffu);
+    }
+}
+
+// Lines are stepped along their major axis, k steps from the first pixel. With errorStep twice
+// the minor extent, the minor coordinate has moved minorSteps(k) pixels by step k.
+static long long minorSteps(long long k, long long dx, long long errorStep)
+{
+    long long t = errorStep * k - dx;
+    return t <= 0 ? 0 : (t + 2 * dx - 1) / (2 * dx);
+}
+
+static void drawClippedLine(Vec2i p0, Vec2i p1, TGAImage &image, const TGAColor &color, int x0, int y0, int x1,
+                            int y1, PixelCounter &counter)
+{
+    bool steep = false;
+    if (std::abs(p0.x - p1.x) < std::abs(p0.y - p1.y))
+    {
+        std::swap(p0.x, p0.y);
+        std::swap(p1.x, p1.y);
+        std::swap(x0, y0);
+        std::swap(x1, y1);
+        steep = true;
+    }
+    if (p0.x > p1.x)
+    {
+        std::swap(p0, p1);
+    }
+    long long dx = p1.x - p0.x;
+    long long dy = p1.y - p0.y;
+    long long errorStep = std::llabs(dy) * 2;
+    int sign = dy > 0 ? 1 : -1;
+
+    // steps that keep the major coordinate inside
+    long long kmin = std::max(0LL, (long long) x0 - p0.x);
+    long long kmax = std::min(dx, (long long) x1 - p0.x);
+    // steps that keep the minor one inside, from the inverse of minorSteps()
+    if (dy == 0)
+    {
+        if (p0.y < y0 || p0.y > y1)
+        {
+            return;
+        }
+    } else
+    {
+        long long nlo = sign > 0 ? (long long) y0 - p0.y : (long long) p0.y - y1;
+        long long nhi = sign > 0 ? (long long) y1 - p0.y : (long long) p0.y - y0;
+        if (nhi < 0)
+        {
+            return;
+        }
+        if (nlo > 0)
+        {
+            kmin = std::max(kmin, (2 * dx * (nlo - 1) + dx) / errorStep + 1);
+        }
+        kmax = std::min(kmax, (2 * dx * nhi + dx) / errorStep);
+    }
+    if (kmin > kmax)
+    {
+        return;
+    }
+
+    long long n = minorSteps(kmin, dx, errorStep);
+    long long error2 = errorStep * kmin - 2 * dx * n;
+    int x = (int) (p0.x + kmin);
+    int y = (int) (p0.y + sign * n);
+    int bytespp = image.get_bytespp();
+    long pitch = (long) image.get_width() * bytespp;
+    long majorStep = steep ? pitch : bytespp;
+    long minorStep = (steep ? bytespp : pitch) * sign;
+    unsigned char *p = image.buffer() + (steep ? (long) x * pitch + (long) y * bytespp
+                                               : (long) y * pitch + (long) x * bytespp);
+    counter.test(kmax - kmin + 1);
+    counter.cover(kmax - kmin + 1);
+    size_t pixel = (p - image.buffer()) / bytespp;
+    for (long long k = kmin; k <= kmax; k++)
+    {
+        memcpy(p, color.bgra, bytespp);
+        counter.write(pixel);
+        p += majorStep;
+        pixel += majorStep / bytespp;
+        error2 += errorStep;
+        if (error2 > dx)
+        {
+            p += minorStep;
+            pixel += minorStep / bytespp;
+            error2 -= dx * 2;
+        }
+    }
+}
+
+void drawLine(Vec2i p0, Vec2i p1, TGAImage &image, const TGAColor &color, int x0, int y0, int x1, int y1)
+{
+    PixelCounter counter(image.get_width(), image.get_height());
+    drawClippedLine(p0, p1, image, color, x0, y0, x1, y1, counter);
+}
+
+WireframeRenderer::WireframeRenderer(ThreadPool *pool) : pool_(pool), model_(nullptr), nindices_(0), edges_(),
+                                                         p0_(), p1_(), bands_()
+{}
+
+static bool onScreen(const VertexBuffer &vertices, int i)
+{
+    // like the triangle renderer, nothing is drawn across the near or far plane
+    return vertices.z[i] >= 0 && vertices.z[i] <= 1 && std::fabs(vertices.x[i]) < WIREFRAME_COORD_LIMIT &&
+           std::fabs(vertices.y[i]) < WIREFRAME_COORD_LIMIT;
+}
+
+int WireframeRenderer::draw(const Model &model, const VertexBuffer &vertices, TGAImage &image,
+                            const TGAColor &color)
+{
+    if (model_ != &model || nindices_ != model.nindices())
+    {
+        buildEdgeList(model, edges_);
+        model_ = &model;
+        nindices_ = model.nindices();
+    }
+    int width = image.get_width();
+    int height = image.get_height();
+    int nbands = pool_ && pool_->size() > 1 ? (height + WIREFRAME_BAND_ROWS - 1) / WIREFRAME_BAND_ROWS : 1;
+    int bandRows = nbands > 1 ? WIREFRAME_BAND_ROWS : height;
+    bands_.resize(nbands);
+    for (int b = 0; b < nbands; b++)
+    {
+        bands_[b].clear();
+    }
+    p0_.resize(edges_.size());
+    p1_.resize(edges_.size());
+    int drawn = 0;
+    for (size_t i = 0; i < edges_.size(); i++)
+    {
+        int v0 = edges_[i].v0;
+        int v1 = edges_[i].v1;
+        if (!onScreen(vertices, v0) || !onScreen(vertices, v1))
+        {
+            continue;
+        }
+        Vec2i p0((int) vertices.x[v0], (int) vertices.y[v0]);
+        Vec2i p1((int) vertices.x[v1], (int) vertices.y[v1]);
+        int ymin = std::max(std::min(p0.y, p1.y), 0);
+        int ymax = std::min(std::max(p0.y, p1.y), height - 1);
+        if (ymin > ymax || std::max(p0.x, p1.x) < 0 || std::min(p0.x, p1.x) >= width)
+        {
+            continue;
+        }
+        p0_[i] = p0;
+        p1_[i] = p1;
+        for (int b = ymin / bandRows; b <= ymax / bandRows; b++)
+        {
+            bands_[b].push_back((int) i);
+        }
+        drawn++;
+    }
+    auto drawBand = [&](int b) {
+        int y0 = b * bandRows;
+        int y1 = std::min(height, y0 + bandRows) - 1;
+        const std::vector<int> &band = bands_[b];
+        PixelCounter counter(width, height);
+        for (size_t i = 0; i < band.size(); i++)
+        {
+            drawClippedLine(p0_[band[i]], p1_[band[i]], image, color, 0, y0, width - 1, y1, counter);
+        }
+    };
+    if (nbands > 1)
+    {
+        pool_->parallelFor(nbands, drawBand);
+    } else
+    {
+        drawBand(0);
+    }
+    return drawn;
+}
@@ -0,0 +1,52 @@
+#ifndef __WIREFRAME_H__
+#define __WIREFRAME_H__
+
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+#include "tgaimage.h"
+#include "threadpool.h"
+#include "transform.h"
+
+// screen rows per parallel wireframe band
+const int WIREFRAME_BAND_ROWS = 64;
+
+struct Edge
+{
+    int v0; // the smaller vertex index
+    int v1;
+};
+
+// Every edge of every face, an edge shared by several faces listed once.
+void buildEdgeList(const Model &model, std::vector<Edge> &edges);
+
+// Bresenham line from p0 to p1 restricted to the rectangle [x0, x1] x [y0, y1], inclusive,
+// which must lie inside the image. The line is clipped before it is stepped: the first pixel
+// inside and the error term there are computed directly, so it lights exactly the pixels of
+// the whole line that fall in the rectangle and writes them without bounds checks.
+void drawLine(Vec2i p0, Vec2i p1, TGAImage &image, const TGAColor &color, int x0, int y0, int x1, int y1);
+
+// Draws the edges of a model as lines. The edge list is built on the first frame of a model and
+// kept for the next ones. With a pool of more than one thread the image is cut into bands of
+// WIREFRAME_BAND_ROWS rows and every band draws the edges crossing it, clipped to the band, so
+// workers never write the same pixel.
+class WireframeRenderer
+{
+private:
+    ThreadPool *pool_;
+    const Model *model_;
+    int nindices_;
+    std::vector<Edge> edges_;
+    std::vector<Vec2i> p0_;
+    std::vector<Vec2i> p1_;
+    std::vector<std::vector<int> > bands_;
+
+public:
+    explicit WireframeRenderer(ThreadPool *pool = nullptr);
+
+    // vertices hold the screen positions of the model vertices; returns the number of edges
+    // that reached the image
+    int draw(const Model &model, const VertexBuffer &vertices, TGAImage &image, const TGAColor &color);
+};
+
+#endif //__WIREFRAME_H__